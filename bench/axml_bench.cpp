@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bench.hpp"
+#include "axml_generator.hpp"
+
+#include "jitana/util/axml_parser.hpp"
+#include "jitana/util/xml_writer.hpp"
+
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+namespace {
+    /// Parses the document with a handler doing nothing, so that only the
+    /// parser is measured.
+    void bench_parse(bench::state& st, const std::vector<char>& doc)
+    {
+        jitana::axml_reader reader;
+        jitana::axml_handler handler;
+        st.set_bytes_per_iteration(doc.size());
+
+        while (st.keep_running()) {
+            reader.read(doc.data(), doc.data() + doc.size(), handler);
+        }
+    }
+
+    /// The strings are decoded when referenced by the CDATA chunks.
+    void bench_string_pool(bench::state& st, bool utf8)
+    {
+        const auto& spec = bench::document_spec();
+        bench_parse(st, bench::make_string_pool_axml(spec.elements
+                                                             * spec.attributes,
+                                                     utf8));
+    }
+
+    void bench_start_element(bench::state& st, bench::value_kind values,
+                             bool utf8)
+    {
+        auto spec = bench::document_spec();
+        spec.values = values;
+        spec.utf8 = utf8;
+        bench_parse(st, bench::make_axml(spec));
+    }
+
+    void bench_xml_writer(bench::state& st)
+    {
+        auto doc = bench::make_axml(bench::document_spec());
+        jitana::axml_reader reader;
+        bench::null_ostream os;
+        st.set_bytes_per_iteration(doc.size());
+
+        while (st.keep_running()) {
+            jitana::xml_writer writer(os);
+            reader.read(doc.data(), doc.data() + doc.size(), writer);
+        }
+    }
+
+    void bench_ptree(bench::state& st)
+    {
+        auto doc = bench::make_axml(bench::document_spec());
+        st.set_bytes_per_iteration(doc.size());
+
+        while (st.keep_running()) {
+            boost::property_tree::ptree pt;
+            jitana::read_axml(doc.data(), doc.data() + doc.size(), pt);
+            bench::do_not_optimize(pt);
+        }
+    }
+
+    using bench::value_kind;
+
+    bench::registrar r1("parse_string_pool/utf8",
+                        [](bench::state& st) { bench_string_pool(st, true); });
+    bench::registrar r2("parse_string_pool/utf16", [](bench::state& st) {
+        bench_string_pool(st, false);
+    });
+    bench::registrar r3("parse_xml_start_element/string/utf8",
+                        [](bench::state& st) {
+                            bench_start_element(st, value_kind::string, true);
+                        });
+    bench::registrar r4("parse_xml_start_element/string/utf16",
+                        [](bench::state& st) {
+                            bench_start_element(st, value_kind::string, false);
+                        });
+    bench::registrar r5("parse_xml_start_element/mixed",
+                        [](bench::state& st) {
+                            bench_start_element(st, value_kind::mixed, true);
+                        });
+
+    /// Returns the benchmark of the attributes with the typed values, which
+    /// are formatted by resource_value.
+    bench::bench_function typed_values(value_kind kind)
+    {
+        return [kind](bench::state& st) {
+            bench_start_element(st, kind, true);
+        };
+    }
+
+    bench::registrar r6("resource_value/int_dec",
+                        typed_values(value_kind::int_dec));
+    bench::registrar r7("resource_value/int_hex",
+                        typed_values(value_kind::int_hex));
+    bench::registrar r8("resource_value/boolean",
+                        typed_values(value_kind::boolean));
+    bench::registrar r9("resource_value/dimension",
+                        typed_values(value_kind::dimension));
+    bench::registrar r10("resource_value/fraction",
+                         typed_values(value_kind::fraction));
+    bench::registrar r11("resource_value/float",
+                         typed_values(value_kind::floating));
+    bench::registrar r12("resource_value/color",
+                         typed_values(value_kind::color));
+    bench::registrar r13("resource_value/reference",
+                         typed_values(value_kind::reference));
+
+    bench::registrar r14("read_axml/xml_writer", bench_xml_writer);
+    bench::registrar r15("read_axml/ptree", bench_ptree);
+}
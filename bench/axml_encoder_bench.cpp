@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bench.hpp"
+#include "axml_generator.hpp"
+#include "event_recorder.hpp"
+
+#include "jitana/util/axml_encoder.hpp"
+#include "jitana/util/axml_parser.hpp"
+
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+namespace {
+    /// Encodes the recorded document with the encoder reused across the
+    /// iterations, as when generating many documents.
+    void bench_encoder(bench::state& st, bool utf8)
+    {
+        auto doc = bench::make_axml(bench::document_spec());
+        bench::event_recorder recorder;
+        jitana::read_axml(doc.data(), doc.data() + doc.size(), recorder);
+
+        jitana::axml_encoder encoder(utf8);
+        recorder.replay(encoder);
+        st.set_bytes_per_iteration(encoder.data().size());
+
+        while (st.keep_running()) {
+            recorder.replay(encoder);
+            bench::do_not_optimize(encoder.data());
+        }
+    }
+
+    void bench_ptree(bench::state& st)
+    {
+        auto doc = bench::make_axml(bench::document_spec());
+        boost::property_tree::ptree pt;
+        jitana::read_axml(doc.data(), doc.data() + doc.size(), pt);
+
+        std::vector<char> out;
+        jitana::write_axml(pt, out);
+        st.set_bytes_per_iteration(out.size());
+
+        while (st.keep_running()) {
+            jitana::write_axml(pt, out);
+            bench::do_not_optimize(out);
+        }
+    }
+
+    bench::registrar r1("write_axml/axml_encoder/utf8",
+                        [](bench::state& st) { bench_encoder(st, true); });
+    bench::registrar r2("write_axml/axml_encoder/utf16",
+                        [](bench::state& st) { bench_encoder(st, false); });
+    bench::registrar r3("write_axml/ptree", bench_ptree);
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "axml_generator.hpp"
+
+#include "jitana/util/android_attrs.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+using namespace bench;
+
+namespace {
+    constexpr uint32_t no_index = 0xffffffff;
+
+    void put16(std::vector<char>& out, uint16_t x)
+    {
+        out.push_back(static_cast<char>(x));
+        out.push_back(static_cast<char>(x >> 8));
+    }
+
+    void put32(std::vector<char>& out, uint32_t x)
+    {
+        put16(out, static_cast<uint16_t>(x));
+        put16(out, static_cast<uint16_t>(x >> 16));
+    }
+
+    void put_chunk_header(std::vector<char>& out, uint16_t type,
+                          uint16_t header_size, uint32_t size)
+    {
+        put16(out, type);
+        put16(out, header_size);
+        put32(out, size);
+    }
+
+    struct attribute {
+        uint32_t ns;
+        uint32_t name;
+        uint32_t raw_value;
+        uint8_t data_type;
+        uint32_t data;
+    };
+
+    /// A binary XML document written chunk by chunk. The strings are added
+    /// to the pool as they are used.
+    class document {
+    public:
+        explicit document(bool utf8) : utf8_(utf8)
+        {
+        }
+
+        uint32_t add_string(const std::string& s)
+        {
+            auto it = string_indices_.find(s);
+            if (it != string_indices_.end()) {
+                return it->second;
+            }
+            const auto index = static_cast<uint32_t>(strings_.size());
+            strings_.push_back(s);
+            string_indices_.emplace(s, index);
+            return index;
+        }
+
+        /// Adds the resource ID of the string added next, which has to be
+        /// an attribute name.
+        void add_attribute_name(const std::string& name, uint32_t id)
+        {
+            add_string(name);
+            resource_ids_.push_back(id);
+        }
+
+        void start_namespace(uint32_t prefix, uint32_t uri)
+        {
+            put_node_header(0x0100, 24);
+            put32(body_, prefix);
+            put32(body_, uri);
+        }
+
+        void end_namespace(uint32_t prefix, uint32_t uri)
+        {
+            put_node_header(0x0101, 24);
+            put32(body_, prefix);
+            put32(body_, uri);
+        }
+
+        void start_element(uint32_t name, const std::vector<attribute>& attrs)
+        {
+            put_node_header(0x0102,
+                            static_cast<uint32_t>(36 + 20 * attrs.size()));
+            put32(body_, no_index);
+            put32(body_, name);
+            put16(body_, 20);
+            put16(body_, 20);
+            put16(body_, static_cast<uint16_t>(attrs.size()));
+            put16(body_, 0);
+            put16(body_, 0);
+            put16(body_, 0);
+            for (const auto& a : attrs) {
+                put32(body_, a.ns);
+                put32(body_, a.name);
+                put32(body_, a.raw_value);
+                put16(body_, 8);
+                body_.push_back(0);
+                body_.push_back(static_cast<char>(a.data_type));
+                put32(body_, a.data);
+            }
+        }
+
+        void end_element(uint32_t name)
+        {
+            put_node_header(0x0103, 24);
+            put32(body_, no_index);
+            put32(body_, name);
+        }
+
+        void cdata(uint32_t text)
+        {
+            put_node_header(0x0104, 28);
+            put32(body_, text);
+            put16(body_, 8);
+            body_.push_back(0);
+            body_.push_back(0x03);
+            put32(body_, text);
+        }
+
+        std::vector<char> finish() const
+        {
+            auto pool = string_pool();
+            std::vector<char> out;
+            const auto resource_map_size = resource_ids_.empty()
+                    ? 0
+                    : 8 + 4 * resource_ids_.size();
+            put_chunk_header(out, 0x0003, 8,
+                             static_cast<uint32_t>(8 + pool.size()
+                                                   + resource_map_size
+                                                   + body_.size()));
+            out.insert(end(out), begin(pool), end(pool));
+            if (!resource_ids_.empty()) {
+                put_chunk_header(out, 0x0180, 8,
+                                 static_cast<uint32_t>(resource_map_size));
+                for (auto id : resource_ids_) {
+                    put32(out, id);
+                }
+            }
+            out.insert(end(out), begin(body_), end(body_));
+            return out;
+        }
+
+    private:
+        void put_node_header(uint16_t type, uint32_t size)
+        {
+            put_chunk_header(body_, type, 16, size);
+            put32(body_, ++line_);
+            put32(body_, no_index);
+        }
+
+        std::vector<char> string_pool() const
+        {
+            // The string lengths fit in the short forms.
+            std::vector<char> data;
+            std::vector<uint32_t> offsets;
+            for (const auto& s : strings_) {
+                offsets.push_back(static_cast<uint32_t>(data.size()));
+                if (utf8_) {
+                    data.push_back(static_cast<char>(s.size()));
+                    data.push_back(static_cast<char>(s.size()));
+                    data.insert(end(data), begin(s), end(s));
+                    data.push_back(0);
+                }
+                else {
+                    put16(data, static_cast<uint16_t>(s.size()));
+                    for (auto c : s) {
+                        put16(data, static_cast<uint8_t>(c));
+                    }
+                    put16(data, 0);
+                }
+            }
+            while (data.size() % 4 != 0) {
+                data.push_back(0);
+            }
+
+            const auto strings_start = 28 + 4 * strings_.size();
+            std::vector<char> out;
+            put_chunk_header(out, 0x0001, 28,
+                             static_cast<uint32_t>(strings_start
+                                                   + data.size()));
+            put32(out, static_cast<uint32_t>(strings_.size()));
+            put32(out, 0);
+            put32(out, utf8_ ? 1 << 8 : 0);
+            put32(out, static_cast<uint32_t>(strings_start));
+            put32(out, 0);
+            for (auto off : offsets) {
+                put32(out, off);
+            }
+            out.insert(end(out), begin(data), end(data));
+            return out;
+        }
+
+    private:
+        bool utf8_;
+        std::vector<std::string> strings_;
+        std::unordered_map<std::string, uint32_t> string_indices_;
+        std::vector<uint32_t> resource_ids_;
+        std::vector<char> body_;
+        uint32_t line_ = 0;
+    };
+
+    attribute make_value(document& doc, value_kind kind, size_t element,
+                         size_t index)
+    {
+        const auto e = static_cast<uint32_t>(element);
+        attribute a{0, 0, no_index, 0, 0};
+        switch (kind) {
+        case value_kind::string:
+            a.raw_value = doc.add_string("value" + std::to_string(element)
+                                         + "." + std::to_string(index));
+            a.data_type = 0x03;
+            a.data = a.raw_value;
+            break;
+        case value_kind::int_dec:
+            a.data_type = 0x10;
+            a.data = e * 31 + 7;
+            break;
+        case value_kind::int_hex:
+            a.data_type = 0x11;
+            a.data = 0x10000000 | e;
+            break;
+        case value_kind::boolean:
+            a.data_type = 0x12;
+            a.data = (e & 1) ? 0xffffffff : 0;
+            break;
+        case value_kind::dimension:
+            a.data_type = 0x05;
+            a.data = ((e % 4096) << 8) | (e % 6);
+            break;
+        case value_kind::fraction:
+            a.data_type = 0x06;
+            a.data = ((e % 4096) << 8) | (1 << 4) | (e % 2);
+            break;
+        case value_kind::floating: {
+            a.data_type = 0x04;
+            const float f = element * 0.25f;
+            std::memcpy(&a.data, &f, sizeof(f));
+            break;
+        }
+        case value_kind::color:
+            a.data_type = 0x1c;
+            a.data = 0xff000000 | (e * 0x010101);
+            break;
+        case value_kind::reference:
+            a.data_type = 0x01;
+            a.data = 0x7f010000 | (e % 0x10000);
+            break;
+        case value_kind::mixed:
+            return make_value(doc, static_cast<value_kind>(index % 9), element,
+                              index);
+        }
+        return a;
+    }
+}
+
+axml_spec& bench::document_spec()
+{
+    static axml_spec spec;
+    return spec;
+}
+
+std::vector<char> bench::make_axml(const axml_spec& spec)
+{
+    static const char* const element_names[]
+            = {"manifest",         "application",  "activity",
+               "intent-filter",    "action",       "category",
+               "service",          "receiver",     "provider",
+               "meta-data",        "uses-feature", "uses-permission",
+               "supports-screens", "uses-sdk",     "permission",
+               "instrumentation"};
+
+    document doc(spec.utf8);
+
+    // The attribute names come first so that they match the resource map.
+    std::vector<uint32_t> attr_names;
+    for (uint32_t id = 0x01010000;
+         attr_names.size() < spec.attributes && id < 0x01020000; ++id) {
+        if (const auto* name = jitana::android_attr_name(id)) {
+            attr_names.push_back(static_cast<uint32_t>(attr_names.size()));
+            doc.add_attribute_name(name, id);
+        }
+    }
+    const auto prefix = doc.add_string("android");
+    const auto uri = doc.add_string(
+            "http://schemas.android.com/apk/res/android");
+    std::vector<uint32_t> names;
+    for (const auto* name : element_names) {
+        names.push_back(doc.add_string(name));
+    }
+
+    // Nest the elements under the root in chains as deep as allowed.
+    const auto depth = spec.depth > 0 ? spec.depth : 1;
+    std::vector<uint32_t> open;
+    std::vector<attribute> attrs;
+    doc.start_namespace(prefix, uri);
+    for (size_t e = 0; e < std::max<size_t>(spec.elements, 1); ++e) {
+        if (open.size() == depth) {
+            while (open.size() > 1) {
+                doc.end_element(open.back());
+                open.pop_back();
+            }
+        }
+
+        attrs.clear();
+        for (size_t i = 0; i < attr_names.size(); ++i) {
+            auto a = make_value(doc, spec.values, e, i);
+            a.ns = uri;
+            a.name = attr_names[i];
+            attrs.push_back(a);
+        }
+        const auto name = names[open.size() % names.size()];
+        doc.start_element(name, attrs);
+        open.push_back(name);
+    }
+    while (!open.empty()) {
+        doc.end_element(open.back());
+        open.pop_back();
+    }
+    doc.end_namespace(prefix, uri);
+
+    return doc.finish();
+}
+
+std::vector<char> bench::make_string_pool_axml(size_t strings, bool utf8)
+{
+    document doc(utf8);
+    const auto root = doc.add_string("resources");
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < strings; ++i) {
+        indices.push_back(doc.add_string("com.example.app.string"
+                                         + std::to_string(i)));
+    }
+
+    doc.start_element(root, {});
+    for (auto i : indices) {
+        doc.cdata(i);
+    }
+    doc.end_element(root);
+
+    return doc.finish();
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef AXMLDEC_BENCH_AXML_GENERATOR_HPP
+#define AXMLDEC_BENCH_AXML_GENERATOR_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace bench {
+    /// The type of the attribute values in a synthetic document.
+    enum class value_kind {
+        string,
+        int_dec,
+        int_hex,
+        boolean,
+        dimension,
+        fraction,
+        floating,
+        color,
+        reference,
+
+        /// All of the above in turn.
+        mixed
+    };
+
+    /// The shape of a synthetic binary XML document.
+    struct axml_spec {
+        /// The number of the elements including the root.
+        size_t elements = 1000;
+
+        /// The number of the android: attributes of each element.
+        size_t attributes = 8;
+
+        /// The maximum nesting depth of the elements.
+        size_t depth = 8;
+
+        /// True for a UTF-8 string pool, false for a UTF-16 one.
+        bool utf8 = false;
+
+        value_kind values = value_kind::mixed;
+    };
+
+    /// Returns the shape of the synthetic documents, which can be changed
+    /// from the command line.
+    axml_spec& document_spec();
+
+    /// Creates a binary XML document resembling a manifest. The string
+    /// values are unique, so the string pool grows with the elements.
+    std::vector<char> make_axml(const axml_spec& spec);
+
+    /// Creates a binary XML document with a string pool of the strings and
+    /// a CDATA chunk referencing each of them once, so that parsing it is
+    /// dominated by the string pool.
+    std::vector<char> make_string_pool_axml(size_t strings, bool utf8);
+}
+
+#endif
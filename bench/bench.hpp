@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef AXMLDEC_BENCH_HPP
+#define AXMLDEC_BENCH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace bench {
+    /// The state of a running benchmark.
+    class state {
+    public:
+        explicit state(size_t iterations) : iterations_(iterations)
+        {
+        }
+
+        /// Returns true while the measured loop should continue. The timer
+        /// starts at the first call so that the setup is not measured.
+        bool keep_running()
+        {
+            if (count_ == 0) {
+                start_ = std::chrono::steady_clock::now();
+            }
+            if (count_++ < iterations_) {
+                return true;
+            }
+            stop_ = std::chrono::steady_clock::now();
+            return false;
+        }
+
+        /// Sets the number of bytes processed by an iteration.
+        void set_bytes_per_iteration(size_t bytes)
+        {
+            bytes_per_iteration_ = bytes;
+        }
+
+        size_t iterations() const
+        {
+            return iterations_;
+        }
+
+        size_t bytes_per_iteration() const
+        {
+            return bytes_per_iteration_;
+        }
+
+        /// Returns the elapsed time of the measured loop in seconds.
+        double elapsed() const
+        {
+            return std::chrono::duration<double>(stop_ - start_).count();
+        }
+
+    private:
+        size_t iterations_;
+        size_t count_ = 0;
+        size_t bytes_per_iteration_ = 0;
+        std::chrono::steady_clock::time_point start_;
+        std::chrono::steady_clock::time_point stop_;
+    };
+
+    using bench_function = std::function<void(state&)>;
+
+    /// Registers a benchmark at the static initialization.
+    struct registrar {
+        registrar(const std::string& name, bench_function fn);
+    };
+
+    /// An output stream discarding what is written, so that the output is
+    /// measured without the cost of storing it.
+    class null_ostream : public std::ostream {
+    public:
+        null_ostream() : std::ostream(&buffer_)
+        {
+        }
+
+    private:
+        struct null_buffer : std::streambuf {
+            int overflow(int c) override
+            {
+                return c;
+            }
+
+            std::streamsize xsputn(const char* /*s*/,
+                                   std::streamsize n) override
+            {
+                return n;
+            }
+        };
+
+        null_buffer buffer_;
+    };
+
+    /// Prevents the compiler from optimizing away the value.
+    template <typename T>
+    inline void do_not_optimize(const T& x)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "r,m"(x) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &x;
+#endif
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef AXMLDEC_BENCH_EVENT_RECORDER_HPP
+#define AXMLDEC_BENCH_EVENT_RECORDER_HPP
+
+#include "jitana/util/axml_parser.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace bench {
+    /// The callbacks of a document recorded to be replayed without parsing.
+    class event_recorder : public jitana::axml_handler {
+    public:
+        enum class type {
+            start_namespace,
+            end_namespace,
+            start_element,
+            attribute,
+            end_element,
+            cdata
+        };
+
+        struct event {
+            type t;
+            std::string a;
+            std::string b;
+        };
+
+        void start_namespace(boost::string_ref prefix,
+                             boost::string_ref uri) override
+        {
+            add(type::start_namespace, prefix, uri);
+        }
+
+        void end_namespace(boost::string_ref prefix,
+                           boost::string_ref uri) override
+        {
+            add(type::end_namespace, prefix, uri);
+        }
+
+        void start_element(boost::string_ref name) override
+        {
+            add(type::start_element, name, "");
+        }
+
+        void attribute(boost::string_ref name,
+                       boost::string_ref value) override
+        {
+            add(type::attribute, name, value);
+        }
+
+        void end_element(boost::string_ref name) override
+        {
+            add(type::end_element, name, "");
+        }
+
+        void cdata(boost::string_ref text) override
+        {
+            add(type::cdata, text, "");
+        }
+
+        void replay(jitana::axml_handler& handler) const
+        {
+            handler.start_document();
+            for (const auto& e : events_) {
+                switch (e.t) {
+                case type::start_namespace:
+                    handler.start_namespace(e.a, e.b);
+                    break;
+                case type::end_namespace:
+                    handler.end_namespace(e.a, e.b);
+                    break;
+                case type::start_element:
+                    handler.start_element(e.a);
+                    break;
+                case type::attribute:
+                    handler.attribute(e.a, e.b);
+                    break;
+                case type::end_element:
+                    handler.end_element(e.a);
+                    break;
+                case type::cdata:
+                    handler.cdata(e.a);
+                    break;
+                }
+            }
+            handler.end_document();
+        }
+
+    private:
+        void add(type t, boost::string_ref a, boost::string_ref b)
+        {
+            events_.push_back({t, a.to_string(), b.to_string()});
+        }
+
+    private:
+        std::vector<event> events_;
+    };
+}
+
+#endif
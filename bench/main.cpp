@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bench.hpp"
+#include "axml_generator.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+namespace {
+    std::vector<std::pair<std::string, bench::bench_function>>& benchmarks()
+    {
+        static std::vector<std::pair<std::string, bench::bench_function>> v;
+        return v;
+    }
+
+    struct result {
+        std::string name;
+        size_t iterations;
+        double ns;
+        double mbps;
+    };
+
+    /// Runs the benchmark, increasing the iterations until the run takes
+    /// long enough.
+    result run(const std::string& name, const bench::bench_function& fn,
+               double min_time)
+    {
+        for (size_t iterations = 1;; iterations *= 2) {
+            bench::state st(iterations);
+            fn(st);
+            if (st.elapsed() < min_time) {
+                continue;
+            }
+
+            double ns = st.elapsed() * 1e9 / iterations;
+            double mbps = st.bytes_per_iteration() * iterations / st.elapsed()
+                    / (1 << 20);
+            return {name, iterations, ns, mbps};
+        }
+    }
+}
+
+bench::registrar::registrar(const std::string& name, bench_function fn)
+{
+    benchmarks().emplace_back(name, std::move(fn));
+}
+
+int main(int argc, char** argv)
+{
+    namespace po = boost::program_options;
+
+    auto& spec = bench::document_spec();
+    po::options_description desc("Allowed options");
+    desc.add_options()("help", "Display available options")(
+            "json", "Write the results as JSON")(
+            "min-time", po::value<double>()->default_value(0.2),
+            "Minimum time of each benchmark in seconds")(
+            "elements", po::value<size_t>(&spec.elements)
+                                ->default_value(spec.elements),
+            "Number of elements in synthetic documents")(
+            "attributes", po::value<size_t>(&spec.attributes)
+                                  ->default_value(spec.attributes),
+            "Number of attributes of each element")(
+            "depth", po::value<size_t>(&spec.depth)->default_value(spec.depth),
+            "Maximum depth of elements")(
+            "filter", po::value<std::string>()->default_value(""),
+            "Run only benchmarks containing this in their names");
+    po::positional_options_description p;
+    p.add("filter", 1);
+
+    po::variables_map vmap;
+    try {
+        po::store(po::command_line_parser(argc, argv)
+                          .options(desc)
+                          .positional(p)
+                          .run(),
+                  vmap);
+        po::notify(vmap);
+    }
+    catch (std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    if (vmap.count("help")) {
+        std::cout << "Usage: axmldec_bench [options] [filter]\n\n";
+        std::cout << desc << "\n";
+        return 0;
+    }
+
+    const auto& filter = vmap["filter"].as<std::string>();
+    const auto min_time = vmap["min-time"].as<double>();
+    const bool json = vmap.count("json") != 0;
+
+    if (json) {
+        std::printf("{\"config\":{\"elements\":%zu,\"attributes\":%zu,"
+                    "\"depth\":%zu,\"min_time\":%g},\"benchmarks\":[",
+                    spec.elements, spec.attributes, spec.depth, min_time);
+    }
+    else {
+        std::printf("%-40s %12s %12s %10s\n", "benchmark", "iterations",
+                    "ns/iter", "MB/s");
+    }
+
+    bool first = true;
+    for (const auto& b : benchmarks()) {
+        if (b.first.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        const auto r = run(b.first, b.second, min_time);
+        if (json) {
+            // The names never need escaping.
+            std::printf("%s\n{\"name\":\"%s\",\"iterations\":%zu,"
+                        "\"ns_per_iteration\":%.1f,\"mb_per_second\":%.1f}",
+                        first ? "" : ",", r.name.c_str(), r.iterations, r.ns,
+                        r.mbps);
+        }
+        else {
+            std::printf("%-40s %12zu %12.1f %10.1f\n", r.name.c_str(),
+                        r.iterations, r.ns, r.mbps);
+        }
+        std::fflush(stdout);
+        first = false;
+    }
+
+    if (json) {
+        std::printf("\n]}\n");
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include "jitana/util/stream_reader.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+    constexpr size_t value_count = 1 << 16;
+
+    template <typename T>
+    void bench_get(bench::state& st)
+    {
+        std::vector<T> values(value_count);
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = static_cast<T>(i * 2654435761u);
+        }
+        jitana::stream_reader reader(values.data(),
+                                     values.data() + values.size());
+        st.set_bytes_per_iteration(values.size() * sizeof(T));
+
+        while (st.keep_running()) {
+            reader.move_head(0);
+            uint32_t sum = 0;
+            for (size_t i = 0; i < value_count; ++i) {
+                sum += reader.get<T>();
+            }
+            bench::do_not_optimize(sum);
+        }
+    }
+
+    /// Encodes the values as uleb128 taking up to the bytes each.
+    std::vector<uint8_t> make_uleb128(size_t max_bytes)
+    {
+        std::vector<uint8_t> data;
+        for (size_t i = 0; i < value_count; ++i) {
+            const auto bits = 7 * (1 + i % max_bytes);
+            auto x = static_cast<uint32_t>(i * 2654435761u);
+            if (bits < 32) {
+                x &= (1u << bits) - 1;
+            }
+            do {
+                uint8_t byte = x & 0x7f;
+                x >>= 7;
+                data.push_back(x ? byte | 0x80 : byte);
+            } while (x);
+        }
+        return data;
+    }
+
+    void bench_get_uleb128(bench::state& st, size_t max_bytes)
+    {
+        auto data = make_uleb128(max_bytes);
+        jitana::stream_reader reader(data.data(), data.data() + data.size());
+        st.set_bytes_per_iteration(data.size());
+
+        while (st.keep_running()) {
+            reader.move_head(0);
+            uint32_t sum = 0;
+            for (size_t i = 0; i < value_count; ++i) {
+                sum += reader.get_uleb128();
+            }
+            bench::do_not_optimize(sum);
+        }
+    }
+
+    bench::registrar r1("stream_reader/get/uint8", bench_get<uint8_t>);
+    bench::registrar r2("stream_reader/get/uint16", bench_get<uint16_t>);
+    bench::registrar r3("stream_reader/get/uint32", bench_get<uint32_t>);
+    bench::registrar r4("stream_reader/get_uleb128/short",
+                        [](bench::state& st) { bench_get_uleb128(st, 1); });
+    bench::registrar r5("stream_reader/get_uleb128/mixed",
+                        [](bench::state& st) { bench_get_uleb128(st, 5); });
+}
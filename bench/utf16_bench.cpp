@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bench.hpp"
+
+#include "jitana/util/utf16.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/locale.hpp>
+
+namespace {
+    /// A string pool with the strings stored back to back.
+    struct utf16_pool {
+        std::vector<uint16_t> units;
+        std::vector<size_t> ends;
+    };
+
+    /// Creates a string pool resembling the one in a manifest. If mixed is
+    /// true, one in four strings contains non-ASCII characters.
+    utf16_pool make_pool(bool mixed)
+    {
+        static const char16_t* words[] = {u"android.permission.INTERNET",
+                                          u"com.example.app.MainActivity",
+                                          u"android.intent.action.MAIN",
+                                          u"screenOrientation",
+                                          u"http://schemas.android.com/apk/"
+                                          u"res/android",
+                                          u"versionName"};
+        static const char16_t* non_ascii_words[]
+                = {u"Приложение", u"アプリケーション", u"café \U0001F600"};
+
+        utf16_pool pool;
+        for (size_t i = 0; i < 4096; ++i) {
+            const auto* w = (mixed && i % 4 == 0) ? non_ascii_words[i % 3]
+                                                  : words[i % 6];
+            for (; *w != 0; ++w) {
+                pool.units.push_back(static_cast<uint16_t>(*w));
+            }
+            pool.ends.push_back(pool.units.size());
+        }
+        return pool;
+    }
+
+    void bench_boost(bench::state& st, bool mixed)
+    {
+        auto pool = make_pool(mixed);
+        st.set_bytes_per_iteration(pool.units.size() * 2);
+
+        while (st.keep_running()) {
+            size_t first = 0;
+            for (auto last : pool.ends) {
+                auto str = boost::locale::conv::utf_to_utf<char>(
+                        pool.units.data() + first, pool.units.data() + last);
+                bench::do_not_optimize(str);
+                first = last;
+            }
+        }
+    }
+
+    void bench_isa(bench::state& st, bool mixed, jitana::utf16_isa isa)
+    {
+        auto pool = make_pool(mixed);
+        st.set_bytes_per_iteration(pool.units.size() * 2);
+        std::vector<char> arena(jitana::utf16_to_utf8_max_size(
+                pool.units.size()));
+
+        while (st.keep_running()) {
+            size_t first = 0;
+            auto* out = arena.data();
+            for (auto last : pool.ends) {
+                out += jitana::utf16_to_utf8(pool.units.data() + first,
+                                             pool.units.data() + last, out,
+                                             isa);
+                first = last;
+            }
+            bench::do_not_optimize(out);
+        }
+    }
+
+    using jitana::utf16_isa;
+
+    bench::registrar r1("utf16/boost/ascii",
+                        [](bench::state& st) { bench_boost(st, false); });
+    bench::registrar r2("utf16/scalar/ascii", [](bench::state& st) {
+        bench_isa(st, false, utf16_isa::scalar);
+    });
+    bench::registrar r3("utf16/sse2/ascii", [](bench::state& st) {
+        bench_isa(st, false, utf16_isa::sse2);
+    });
+    bench::registrar r4("utf16/avx2/ascii", [](bench::state& st) {
+        bench_isa(st, false, utf16_isa::avx2);
+    });
+    bench::registrar r5("utf16/boost/mixed",
+                        [](bench::state& st) { bench_boost(st, true); });
+    bench::registrar r6("utf16/scalar/mixed", [](bench::state& st) {
+        bench_isa(st, true, utf16_isa::scalar);
+    });
+    bench::registrar r7("utf16/sse2/mixed", [](bench::state& st) {
+        bench_isa(st, true, utf16_isa::sse2);
+    });
+    bench::registrar r8("utf16/avx2/mixed", [](bench::state& st) {
+        bench_isa(st, true, utf16_isa::avx2);
+    });
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "bench.hpp"
+#include "axml_generator.hpp"
+#include "event_recorder.hpp"
+
+#include "jitana/util/axml_parser.hpp"
+#include "jitana/util/xml_writer.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+namespace {
+    void bench_xml_writer(bench::state& st)
+    {
+        auto doc = bench::make_axml(bench::document_spec());
+        bench::event_recorder recorder;
+        jitana::read_axml(doc.data(), doc.data() + doc.size(), recorder);
+
+        std::ostringstream oss;
+        {
+            jitana::xml_writer writer(oss);
+            recorder.replay(writer);
+        }
+        st.set_bytes_per_iteration(oss.str().size());
+
+        bench::null_ostream os;
+        while (st.keep_running()) {
+            jitana::xml_writer writer(os);
+            recorder.replay(writer);
+        }
+    }
+
+    void bench_ptree(bench::state& st)
+    {
+        namespace boost_pt = boost::property_tree;
+
+        auto doc = bench::make_axml(bench::document_spec());
+        boost_pt::ptree pt;
+        jitana::read_axml(doc.data(), doc.data() + doc.size(), pt);
+#if BOOST_MAJOR_VERSION == 1 && BOOST_MINOR_VERSION < 56
+        boost_pt::xml_writer_settings<char> settings(' ', 2);
+#else
+        boost_pt::xml_writer_settings<std::string> settings(' ', 2);
+#endif
+
+        std::ostringstream oss;
+        boost_pt::write_xml(oss, pt, settings);
+        st.set_bytes_per_iteration(oss.str().size());
+
+        bench::null_ostream os;
+        while (st.keep_running()) {
+            boost_pt::write_xml(os, pt, settings);
+        }
+    }
+
+    bench::registrar r1("write_xml/xml_writer", bench_xml_writer);
+    bench::registrar r2("write_xml/ptree", bench_ptree);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_ANDROID_ATTRS_HPP
+#define JITANA_ANDROID_ATTRS_HPP
+
+#include <cstdint>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace jitana {
+    /// Returns the name of the Android framework attribute with the resource
+    /// ID, or nullptr if the ID is unknown.
+    const char* android_attr_name(uint32_t id);
+
+    /// Returns the resource ID of the Android framework attribute with the
+    /// name, or 0 if the name is unknown.
+    uint32_t android_attr_id(boost::string_ref name);
+
+    /// Returns true if the Android framework attribute with the resource ID
+    /// is of the string format, whose values aapt never encodes as typed
+    /// values.
+    bool android_attr_is_string(uint32_t id);
+}
+
+#endif
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_AXML_DOCUMENT_HPP
+#define JITANA_AXML_DOCUMENT_HPP
+
+#include "jitana/util/axml_parser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace jitana {
+    /// A compact read-only DOM of a binary XML file.
+    ///
+    /// The nodes are stored in document order in a single array, the
+    /// attributes in another, and the strings are interned in one character
+    /// buffer. Nodes and attributes refer to each other by indices, so the
+    /// whole document is a handful of allocations no matter how many elements
+    /// it has. The namespace declarations are kept as xmlns attributes of the
+    /// elements declaring them as in the tree produced by read_axml().
+    class axml_document {
+    public:
+        enum class node_kind : uint8_t { document, element, text };
+
+    private:
+        struct node_data {
+            node_kind kind;
+            uint32_t str;
+            uint32_t parent;
+            /// The index after the last descendant, which is the next
+            /// sibling if any.
+            uint32_t end;
+            uint32_t attr_first;
+            uint32_t attr_last;
+        };
+
+        struct attribute_data {
+            uint32_t name;
+            uint32_t value;
+        };
+
+        struct string_data {
+            uint32_t offset;
+            uint32_t size;
+        };
+
+    public:
+        class node;
+        class attribute;
+
+        /// A forward iterator over the child nodes of a node.
+        class child_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = node;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = node;
+
+            child_iterator() = default;
+
+            child_iterator(const axml_document* doc, uint32_t index)
+                    : doc_(doc), index_(index)
+            {
+            }
+
+            node operator*() const;
+
+            child_iterator& operator++()
+            {
+                index_ = doc_->nodes_[index_].end;
+                return *this;
+            }
+
+            child_iterator operator++(int)
+            {
+                auto old = *this;
+                ++*this;
+                return old;
+            }
+
+            friend bool operator==(const child_iterator& x,
+                                   const child_iterator& y)
+            {
+                return x.index_ == y.index_;
+            }
+
+            friend bool operator!=(const child_iterator& x,
+                                   const child_iterator& y)
+            {
+                return !(x == y);
+            }
+
+        private:
+            const axml_document* doc_ = nullptr;
+            uint32_t index_ = 0;
+        };
+
+        /// A random access iterator over the attributes of an element.
+        class attribute_iterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = attribute;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = attribute;
+
+            attribute_iterator() = default;
+
+            attribute_iterator(const axml_document* doc, uint32_t index)
+                    : doc_(doc), index_(index)
+            {
+            }
+
+            attribute operator*() const;
+
+            attribute operator[](difference_type n) const
+            {
+                return *(*this + n);
+            }
+
+            attribute_iterator& operator++()
+            {
+                ++index_;
+                return *this;
+            }
+
+            attribute_iterator operator++(int)
+            {
+                auto old = *this;
+                ++index_;
+                return old;
+            }
+
+            attribute_iterator& operator--()
+            {
+                --index_;
+                return *this;
+            }
+
+            attribute_iterator operator--(int)
+            {
+                auto old = *this;
+                --index_;
+                return old;
+            }
+
+            attribute_iterator& operator+=(difference_type n)
+            {
+                index_ = static_cast<uint32_t>(index_ + n);
+                return *this;
+            }
+
+            attribute_iterator& operator-=(difference_type n)
+            {
+                index_ = static_cast<uint32_t>(index_ - n);
+                return *this;
+            }
+
+            friend attribute_iterator operator+(attribute_iterator it,
+                                                difference_type n)
+            {
+                return it += n;
+            }
+
+            friend attribute_iterator operator-(attribute_iterator it,
+                                                difference_type n)
+            {
+                return it -= n;
+            }
+
+            friend difference_type operator-(const attribute_iterator& x,
+                                             const attribute_iterator& y)
+            {
+                return static_cast<difference_type>(x.index_)
+                        - static_cast<difference_type>(y.index_);
+            }
+
+            friend bool operator==(const attribute_iterator& x,
+                                   const attribute_iterator& y)
+            {
+                return x.index_ == y.index_;
+            }
+
+            friend bool operator!=(const attribute_iterator& x,
+                                   const attribute_iterator& y)
+            {
+                return !(x == y);
+            }
+
+            friend bool operator<(const attribute_iterator& x,
+                                  const attribute_iterator& y)
+            {
+                return x.index_ < y.index_;
+            }
+
+        private:
+            const axml_document* doc_ = nullptr;
+            uint32_t index_ = 0;
+        };
+
+        /// A pair of iterators usable in a range-based for loop.
+        template <typename Iterator>
+        class range {
+        public:
+            range(Iterator first, Iterator last) : first_(first), last_(last)
+            {
+            }
+
+            Iterator begin() const
+            {
+                return first_;
+            }
+
+            Iterator end() const
+            {
+                return last_;
+            }
+
+            bool empty() const
+            {
+                return first_ == last_;
+            }
+
+        private:
+            Iterator first_;
+            Iterator last_;
+        };
+
+        /// A lightweight handle to an attribute.
+        class attribute {
+        public:
+            boost::string_ref name() const
+            {
+                return doc_->string(doc_->attributes_[index_].name);
+            }
+
+            boost::string_ref value() const
+            {
+                return doc_->string(doc_->attributes_[index_].value);
+            }
+
+        private:
+            friend class attribute_iterator;
+
+            attribute(const axml_document* doc, uint32_t index)
+                    : doc_(doc), index_(index)
+            {
+            }
+
+            const axml_document* doc_;
+            uint32_t index_;
+        };
+
+        /// A lightweight handle to a node. It stays valid as long as the
+        /// document is alive and unmodified.
+        class node {
+        public:
+            node_kind kind() const
+            {
+                return data().kind;
+            }
+
+            bool is_element() const
+            {
+                return kind() == node_kind::element;
+            }
+
+            bool is_text() const
+            {
+                return kind() == node_kind::text;
+            }
+
+            /// Returns the name of the element, or the character data of the
+            /// text node.
+            boost::string_ref name() const
+            {
+                return doc_->string(data().str);
+            }
+
+            /// Returns the character data of the text node.
+            boost::string_ref text() const
+            {
+                return doc_->string(data().str);
+            }
+
+            /// Returns the parent node. The parent of the document node is
+            /// itself.
+            node parent() const
+            {
+                return node(doc_, data().parent);
+            }
+
+            range<child_iterator> children() const
+            {
+                return {child_iterator(doc_, index_ + 1),
+                        child_iterator(doc_, data().end)};
+            }
+
+            range<attribute_iterator> attributes() const
+            {
+                const auto& d = data();
+                return {attribute_iterator(doc_, d.attr_first),
+                        attribute_iterator(doc_, d.attr_last)};
+            }
+
+            /// Returns the value of the first attribute with the name.
+            boost::optional<boost::string_ref>
+            find_attribute(boost::string_ref name) const;
+
+            /// Returns the first child element with the name.
+            boost::optional<node> find_child(boost::string_ref name) const;
+
+            friend bool operator==(const node& x, const node& y)
+            {
+                return x.doc_ == y.doc_ && x.index_ == y.index_;
+            }
+
+            friend bool operator!=(const node& x, const node& y)
+            {
+                return !(x == y);
+            }
+
+        private:
+            friend class axml_document;
+            friend class child_iterator;
+
+            node(const axml_document* doc, uint32_t index)
+                    : doc_(doc), index_(index)
+            {
+            }
+
+            const node_data& data() const
+            {
+                return doc_->nodes_[index_];
+            }
+
+            const axml_document* doc_;
+            uint32_t index_;
+        };
+
+        /// A handler filling the document from the parser.
+        class builder : public axml_handler {
+        public:
+            /// Creates a builder replacing the content of the document.
+            explicit builder(axml_document& doc);
+
+            void start_document() override;
+            void end_document() override;
+            void start_namespace(boost::string_ref prefix,
+                                 boost::string_ref uri) override;
+            void end_namespace(boost::string_ref prefix,
+                               boost::string_ref uri) override;
+            void start_element(boost::string_ref name) override;
+            void attribute(boost::string_ref name,
+                           boost::string_ref value) override;
+            void end_element(boost::string_ref name) override;
+            void cdata(boost::string_ref text) override;
+
+        private:
+            struct string_hash {
+                const axml_document* doc;
+                size_t operator()(uint32_t idx) const;
+            };
+
+            struct string_equal {
+                const axml_document* doc;
+                bool operator()(uint32_t x, uint32_t y) const;
+            };
+
+            uint32_t intern(boost::string_ref s);
+            void start_node(node_kind kind, uint32_t str);
+            void end_node();
+
+        private:
+            axml_document& doc_;
+
+            /// The open nodes and the namespaces declared in them. Each
+            /// node owns the namespaces after its namespace offset.
+            std::vector<std::pair<uint32_t, size_t>> stack_;
+            std::vector<std::pair<uint32_t, uint32_t>> namespaces_;
+
+            /// The interned strings.
+            std::unordered_set<uint32_t, string_hash, string_equal> table_;
+            std::string scratch_;
+        };
+
+        /// Creates an empty document.
+        axml_document();
+
+        /// Returns the document node, whose children are the top-level
+        /// nodes.
+        node root() const
+        {
+            return node(this, 0);
+        }
+
+        /// Returns the first top-level element, or the document node if there
+        /// is none.
+        node root_element() const;
+
+        /// Returns the number of nodes including the document node.
+        size_t node_count() const
+        {
+            return nodes_.size();
+        }
+
+        /// Returns the number of bytes used by the document.
+        size_t memory_usage() const;
+
+        /// Removes all the nodes and releases the memory.
+        void clear();
+
+    private:
+        boost::string_ref string(uint32_t idx) const
+        {
+            const auto& s = strings_[idx];
+            return boost::string_ref(chars_.data() + s.offset, s.size);
+        }
+
+    private:
+        std::vector<node_data> nodes_;
+        std::vector<attribute_data> attributes_;
+        std::vector<string_data> strings_;
+        std::string chars_;
+    };
+
+    inline axml_document::node axml_document::child_iterator::operator*() const
+    {
+        return node(doc_, index_);
+    }
+
+    inline axml_document::attribute
+    axml_document::attribute_iterator::operator*() const
+    {
+        return attribute(doc_, index_);
+    }
+
+    void read_axml(const std::string& filename, axml_document& doc);
+
+    void read_axml(std::istream& stream, axml_document& doc);
+
+    void read_axml(const void* first, const void* last, axml_document& doc);
+
+    /// Converts the document to the same tree read_axml() produces.
+    void to_ptree(const axml_document& doc, boost::property_tree::ptree& pt);
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_AXML_ENCODER_HPP
+#define JITANA_AXML_ENCODER_HPP
+
+#include "jitana/util/axml_parser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace jitana {
+    struct axml_encoder_error : std::runtime_error {
+        using runtime_error::runtime_error;
+    };
+
+    /// A handler encoding what it receives into binary XML, the reverse of
+    /// xml_writer.
+    ///
+    /// The strings are deduplicated into a single pool. The attributes of
+    /// the Android framework are put in the resource map and sorted by
+    /// their resource IDs as the platform expects. The attribute values
+    /// looking like integers, booleans, colors, dimensions, or fractions are
+    /// encoded as typed values the same way aapt does; the others are
+    /// strings.
+    class axml_encoder : public axml_handler {
+    public:
+        /// Creates an encoder. The string pool is UTF-16 like the ones aapt
+        /// writes unless utf8 is true.
+        explicit axml_encoder(bool utf8 = false);
+
+        void start_document() override;
+        void end_document() override;
+        void start_namespace(boost::string_ref prefix,
+                             boost::string_ref uri) override;
+        void end_namespace(boost::string_ref prefix,
+                           boost::string_ref uri) override;
+        void start_element(boost::string_ref name) override;
+        void attribute(boost::string_ref name,
+                       boost::string_ref value) override;
+        void end_element(boost::string_ref name) override;
+        void cdata(boost::string_ref text) override;
+
+        /// Returns the binary XML encoded by end_document().
+        const std::vector<char>& data() const
+        {
+            return data_;
+        }
+
+    private:
+        /// A node of the document. The string references are the indices
+        /// in strings_, or the ones in mapped_names_ with mapped_flag.
+        struct node {
+            uint16_t type;
+            uint32_t ns;
+            uint32_t name;
+            uint32_t first_attribute;
+            uint32_t attribute_count;
+        };
+
+        struct attribute_entry {
+            uint32_t ns;
+            uint32_t name;
+            uint32_t raw_value;
+            uint8_t data_type;
+            uint32_t data;
+            uint32_t resource_id;
+        };
+
+        /// A namespace declaration with the index of the URI.
+        struct namespace_entry {
+            std::string prefix;
+            uint32_t uri;
+            bool android;
+        };
+
+        static constexpr uint32_t no_string = 0xffffffff;
+        static constexpr uint32_t mapped_flag = 0x80000000;
+
+        uint32_t add_string(boost::string_ref s);
+        uint32_t add_mapped_name(boost::string_ref name, uint32_t id);
+        void add_node(uint16_t type, uint32_t ns, uint32_t name);
+        void close_start_element();
+        void write_string_pool(const std::vector<uint32_t>& mapped_order);
+        void write_string(const std::string& s);
+
+    private:
+        bool utf8_;
+
+        std::vector<std::string> strings_;
+        std::unordered_map<std::string, uint32_t> string_indices_;
+
+        /// The attribute names with the resource IDs, which go first in the
+        /// string pool in the order of the IDs.
+        std::vector<std::pair<uint32_t, std::string>> mapped_names_;
+        std::unordered_map<uint32_t, uint32_t> mapped_name_indices_;
+
+        std::vector<node> nodes_;
+        std::vector<attribute_entry> attributes_;
+        bool in_start_element_ = false;
+
+        /// The buffers reused to avoid allocations.
+        std::string key_;
+        std::u16string units_;
+
+        /// The namespaces in scope.
+        std::vector<namespace_entry> namespaces_;
+
+        std::vector<char> data_;
+    };
+
+    /// Encodes the tree, in the format read_xml() or read_axml() fills,
+    /// into binary XML. The "xmlns" attributes become the namespace
+    /// declarations.
+    void write_axml(const boost::property_tree::ptree& pt,
+                    std::vector<char>& data, bool utf8 = false);
+}
+
+#endif
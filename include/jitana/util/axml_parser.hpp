@@ -19,10 +19,14 @@
 
 #include "jitana/util/stream_reader.hpp"
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
 #include <boost/property_tree/ptree.hpp>
+#include <boost/utility/string_ref.hpp>
 
 namespace jitana {
     struct axml_parser_error : std::runtime_error {
@@ -33,10 +37,158 @@ namespace jitana {
         using axml_parser_error::axml_parser_error;
     };
 
+    /// A push-style handler receiving the content of a binary XML file as it
+    /// is parsed.
+    ///
+    /// The strings passed to the callbacks are only valid during the call.
+    /// All callbacks do nothing by default.
+    class axml_handler {
+    public:
+        virtual ~axml_handler() = default;
+
+        /// Called before any other callback.
+        virtual void start_document()
+        {
+        }
+
+        /// Called after all the content is reported.
+        virtual void end_document()
+        {
+        }
+
+        /// Called when a namespace declaration comes into scope. It is called
+        /// before start_element() of the element declaring the namespace.
+        virtual void start_namespace(boost::string_ref /*prefix*/,
+                                     boost::string_ref /*uri*/)
+        {
+        }
+
+        /// Called when a namespace declaration goes out of scope.
+        virtual void end_namespace(boost::string_ref /*prefix*/,
+                                   boost::string_ref /*uri*/)
+        {
+        }
+
+        /// Called at the beginning of an element. The attributes of the
+        /// element are reported by attribute() right after this call.
+        virtual void start_element(boost::string_ref /*name*/)
+        {
+        }
+
+        /// Called for each attribute of the last started element. The name
+        /// includes the namespace prefix if any.
+        virtual void attribute(boost::string_ref /*name*/,
+                               boost::string_ref /*value*/)
+        {
+        }
+
+        /// Called at the end of an element.
+        virtual void end_element(boost::string_ref /*name*/)
+        {
+        }
+
+        /// Called for the character data inside an element.
+        virtual void cdata(boost::string_ref /*text*/)
+        {
+        }
+    };
+
+    class axml_parser;
+    class decode_stats;
+    class resource_table;
+
+    /// A binary XML parser reused across documents.
+    ///
+    /// The tables and buffers of the parser are kept after each document,
+    /// so parsing many small documents in a row does not allocate them
+    /// again. It is not thread safe; use one per thread.
+    class axml_reader {
+    public:
+        axml_reader();
+
+        ~axml_reader();
+
+        axml_reader(const axml_reader&) = delete;
+        axml_reader& operator=(const axml_reader&) = delete;
+
+        /// Sets the resource table used to print the references in the
+        /// attribute values by name. The table must outlive the reader.
+        /// Null disables it.
+        void set_resource_table(const resource_table* table);
+
+        /// Sets the statistics to collect the string pool time and the
+        /// counts of the chunks into. Null disables it.
+        void set_stats(decode_stats* stats);
+
+        /// Parses the whole binary XML in the memory range.
+        void read(const void* first, const void* last, axml_handler& handler);
+
+    private:
+        axml_handler null_handler_;
+        std::unique_ptr<axml_parser> parser_;
+    };
+
+    /// A parser taking the binary XML in pieces as they become available.
+    ///
+    /// Each chunk is parsed as soon as it is complete. Only the string pool
+    /// and the incomplete chunk at the end of the data fed so far are kept,
+    /// so the whole file is never held in memory.
+    class axml_push_parser {
+    public:
+        /// Creates a parser reporting the content to the handler. If the
+        /// resource table is specified, the references in the attribute
+        /// values are printed by name.
+        explicit axml_push_parser(axml_handler& handler,
+                                  const resource_table* table = nullptr);
+
+        ~axml_push_parser();
+
+        /// Parses the next piece of the binary XML.
+        void feed(const void* data, size_t size);
+
+        /// Ends the document. Throws if the document is incomplete.
+        void finish();
+
+        /// Sets the statistics to collect the string pool time and the
+        /// counts of the chunks into. Null disables it.
+        void set_stats(decode_stats* stats);
+
+    private:
+        /// Returns true if the rest of the data is after the document.
+        bool done() const
+        {
+            return started_ && consumed_ >= doc_size_;
+        }
+
+        size_t unit_size(const uint8_t* p) const;
+        void parse_unit(const uint8_t* first, const uint8_t* last);
+
+    private:
+        std::unique_ptr<axml_parser> parser_;
+        std::vector<uint8_t> buffer_;
+        bool started_ = false;
+        uint64_t doc_size_ = 0;
+        uint64_t consumed_ = 0;
+    };
+
     void read_axml(const std::string& filename,
                    boost::property_tree::ptree& pt);
 
     void read_axml(std::istream& stream, boost::property_tree::ptree& pt);
+
+    void read_axml(const void* first, const void* last,
+                   boost::property_tree::ptree& pt);
+
+    void read_axml(const std::string& filename, axml_handler& handler);
+
+    void read_axml(std::istream& stream, axml_handler& handler);
+
+    void read_axml(const void* first, const void* last, axml_handler& handler);
+
+    /// Parses the binary XML in the memory range, printing the references in
+    /// the attribute values by name using the resource table.
+    void read_axml(const void* first, const void* last, axml_handler& handler,
+                   const resource_table& table);
 }
 
 #endif
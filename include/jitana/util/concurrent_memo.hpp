@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_CONCURRENT_MEMO_HPP
+#define JITANA_CONCURRENT_MEMO_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace jitana {
+    /// The cost of a value in concurrent_memo counting each value as one.
+    struct unit_cost {
+        template <typename Key, typename Value>
+        size_t operator()(const Key&, const Value&) const
+        {
+            return 1;
+        }
+    };
+
+    /// A table of the values computed from the keys, shared by multiple
+    /// threads, which computes the value of each key only once.
+    ///
+    /// The first thread asking for a key computes the value without holding
+    /// any lock, and the others asking for the same key in the meantime wait
+    /// for it instead of computing it again. An exception thrown by the
+    /// computation is rethrown to all of them, but it is not kept; the key
+    /// is dropped and the next thread asking for it computes it again. The
+    /// keys are spread over the shards, each of which has its own lock, so
+    /// the threads asking for different keys rarely contend.
+    ///
+    /// If the capacity is given, the least recently used values are dropped
+    /// once the sum of their costs exceeds it. The capacity is divided
+    /// evenly among the shards.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>,
+              typename Cost = unit_cost>
+    class concurrent_memo {
+    public:
+        /// Creates a memo keeping the values up to the capacity, or all of
+        /// them if the capacity is zero.
+        explicit concurrent_memo(size_t capacity = 0, size_t shard_count = 16)
+        {
+            shards_.reserve(shard_count);
+            for (size_t i = 0; i < shard_count; ++i) {
+                shards_.emplace_back(new shard);
+                shards_.back()->capacity
+                        = capacity ? std::max<size_t>(capacity / shard_count, 1)
+                                   : 0;
+            }
+        }
+
+        concurrent_memo(const concurrent_memo&) = delete;
+        concurrent_memo& operator=(const concurrent_memo&) = delete;
+
+        /// Returns the value of the key, calling compute() to get it if no
+        /// thread has asked for the key yet.
+        template <typename Compute>
+        std::shared_ptr<const Value> get(const Key& key, Compute compute)
+        {
+            auto& s = *shards_[hash_(key) % shards_.size()];
+
+            std::promise<std::shared_ptr<const Value>> promise;
+            std::shared_future<std::shared_ptr<const Value>> future;
+            uint64_t serial;
+            {
+                std::unique_lock<std::mutex> lock(s.mutex);
+                auto it = s.values.find(key);
+                if (it != s.values.end()) {
+                    // Wait for the value outside the lock.
+                    s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+                    future = it->second.future;
+                    lock.unlock();
+                    ++hits_;
+                    return future.get();
+                }
+                future = promise.get_future().share();
+                serial = ++s.serial;
+                it = s.values.emplace(key, entry{future, {}, serial, 0}).first;
+                s.lru.push_front(&it->first);
+                it->second.lru = s.lru.begin();
+            }
+
+            std::shared_ptr<const Value> value;
+            try {
+                value = std::make_shared<const Value>(compute());
+                promise.set_value(value);
+            }
+            catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+
+            if (!value) {
+                drop(s, key, serial);
+            }
+            else if (s.capacity) {
+                charge(s, key, serial, cost_(key, *value));
+            }
+            return future.get();
+        }
+
+        /// Returns the number of the times a value was reused instead of
+        /// being computed.
+        size_t hits() const
+        {
+            return hits_;
+        }
+
+    private:
+        struct entry {
+            std::shared_future<std::shared_ptr<const Value>> future;
+            typename std::list<const Key*>::iterator lru;
+
+            /// Tells the entry from the one added again after eviction.
+            uint64_t serial;
+
+            /// Zero until the value is computed.
+            size_t cost;
+        };
+
+        struct shard {
+            std::mutex mutex;
+            std::unordered_map<Key, entry, Hash> values;
+
+            /// The keys in values, the most recently used first.
+            std::list<const Key*> lru;
+
+            size_t capacity = 0;
+            size_t cost = 0;
+            uint64_t serial = 0;
+        };
+
+        /// Adds the cost of the computed value, and drops the least recently
+        /// used values until the shard is within the capacity.
+        void charge(shard& s, const Key& key, uint64_t serial, size_t cost)
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto it = s.values.find(key);
+            if (it == s.values.end() || it->second.serial != serial) {
+                // Dropped already.
+                return;
+            }
+            it->second.cost = cost;
+            s.cost += cost;
+
+            while (s.cost > s.capacity && !s.lru.empty()) {
+                auto victim = s.values.find(*s.lru.back());
+                s.cost -= victim->second.cost;
+                s.lru.pop_back();
+                s.values.erase(victim);
+            }
+        }
+
+        /// Drops the entry whose computation failed, which has no cost.
+        void drop(shard& s, const Key& key, uint64_t serial)
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto it = s.values.find(key);
+            if (it == s.values.end() || it->second.serial != serial) {
+                // Dropped already.
+                return;
+            }
+            s.lru.erase(it->second.lru);
+            s.values.erase(it);
+        }
+
+    private:
+        Hash hash_;
+        Cost cost_;
+        std::vector<std::unique_ptr<shard>> shards_;
+        std::atomic<size_t> hits_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_CRC32_HPP
+#define JITANA_CRC32_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jitana {
+    /// The instruction sets crc32_update() can use.
+    enum class crc32_isa { scalar, pclmul };
+
+    /// Returns the best instruction set supported by the running CPU.
+    crc32_isa crc32_best_isa();
+
+    /// Updates the CRC-32 used by ZIP and zlib with the data using the best
+    /// instruction set. The initial value is 0.
+    uint32_t crc32_update(uint32_t crc, const void* data, size_t size);
+
+    /// Updates the CRC-32 with the data using the specified instruction set.
+    /// An instruction set unsupported by the CPU falls back to the best
+    /// supported one.
+    uint32_t crc32_update(uint32_t crc, const void* data, size_t size,
+                          crc32_isa isa);
+}
+
+#endif
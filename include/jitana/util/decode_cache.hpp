@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_DECODE_CACHE_HPP
+#define JITANA_DECODE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace jitana {
+    struct decode_cache_error : std::runtime_error {
+        using runtime_error::runtime_error;
+    };
+
+    /// What the decoded result of an APK depends on. All of them are known
+    /// from the file system and the central directory of the APK, so a hit
+    /// needs neither inflation nor parsing.
+    struct decode_cache_key {
+        std::string path;
+        uint64_t file_size;
+        int64_t mtime;
+        uint32_t manifest_crc32;
+        uint64_t manifest_size;
+
+        /// The CRC-32 of resources.arsc, which is used to print the
+        /// references, or zero if there is none.
+        uint32_t resources_crc32;
+    };
+
+    /// A persistent cache of the decoded XML files in a directory.
+    ///
+    /// The directory has an index, which is an open addressing hash table
+    /// memory-mapped for the lookups, and a data file the decoded files are
+    /// appended to. The entries inserted are kept in memory, where find()
+    /// also looks, until flush() merges them into the files under an
+    /// exclusive file lock. The index
+    /// is replaced by renaming a new one over it, so the readers mapping the
+    /// old one are never affected.
+    ///
+    /// Each path has at most one entry; inserting a new key of a path
+    /// replaces the old one. The data of the entries replaced is left in
+    /// the data file until it takes half of the file. flush() then copies
+    /// the live data to a new data file, which the new index refers to, and
+    /// removes the old one.
+    class decode_cache {
+    public:
+        /// Opens the cache in the directory, creating it if needed.
+        explicit decode_cache(const std::string& dir);
+
+        decode_cache(const decode_cache&) = delete;
+        decode_cache& operator=(const decode_cache&) = delete;
+
+        /// Finds the decoded XML of the key in the entries inserted or in the
+        /// files as of when the cache was opened or last flushed. It can be
+        /// called from multiple threads.
+        bool find(const decode_cache_key& key, std::string& xml) const;
+
+        /// Adds the decoded XML of the key. It can be called from multiple
+        /// threads.
+        void insert(const decode_cache_key& key, boost::string_ref xml);
+
+        /// Writes the entries inserted to the files and maps them again.
+        /// It must not be called while other threads are using the cache.
+        void flush();
+
+    private:
+        /// The record of an entry in the index.
+        struct record {
+            uint64_t hash;
+            uint64_t file_size;
+            int64_t mtime;
+            uint64_t manifest_size;
+            uint32_t manifest_crc32;
+            uint32_t resources_crc32;
+            uint64_t data_offset;
+            uint32_t path_size;
+            uint32_t used;
+            uint64_t xml_size;
+        };
+
+    private:
+        struct pending_entry {
+            decode_cache_key key;
+            std::string xml;
+        };
+
+        void map_files();
+
+    private:
+        std::string dir_;
+
+        /// The snapshot of the files when the cache is opened.
+        boost::iostreams::mapped_file_source index_file_;
+        boost::iostreams::mapped_file_source data_file_;
+        const record* records_ = nullptr;
+        uint64_t capacity_ = 0;
+        uint64_t generation_ = 0;
+
+        /// The entries inserted but not written yet by path. Inserting a
+        /// path again replaces its entry, so a long running process holds
+        /// one entry per path at most.
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, pending_entry> pending_;
+    };
+}
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef JITANA_DECODE_STATS_HPP
+#define JITANA_DECODE_STATS_HPP
+
+#include "jitana/util/axml_parser.hpp"
+#include "jitana/util/perf_counters.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+
+#include <boost/utility/string_ref.hpp>
+
+namespace jitana {
+    /// The phases of decoding a file.
+    enum class decode_phase {
+        /// Opening the APK and finding the entries.
+        zip_lookup,
+
+        /// Inflating the compressed entries.
+        inflate,
+
+        /// Reading the string pool and decoding the strings.
+        string_pool,
+
+        /// Parsing the chunks of the elements, or the text XML.
+        element_loop,
+
+        /// Writing the text XML.
+        serialization,
+
+        /// Anything else, such as reading resources.arsc.
+        other,
+
+        /// Not a phase; the number of the phases.
+        count
+    };
+
+    /// Returns the name of the phase.
+    const char* decode_phase_name(decode_phase phase);
+
+    /// Returns the peak resident set size of the process in bytes, or 0 if
+    /// unknown.
+    uint64_t peak_rss_bytes();
+
+    /// The heap allocations made in a phase.
+    struct alloc_counts {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+
+        /// The largest live bytes reached in the phase, counted from the
+        /// start of the input.
+        uint64_t peak_live_bytes = 0;
+    };
+
+    /// The statistics of decoding files. They are only collected by the
+    /// parts given a pointer to it, so nothing is measured by default.
+    ///
+    /// The phases are timed exclusively: starting a phase pauses the
+    /// running one until it ends, so nested phases are not counted twice.
+    /// A decode_stats is not thread safe; use one per thread and merge them.
+    ///
+    /// The hardware events can be counted in each phase as well. As the
+    /// counters are read at every switch of the phases, this slows down the
+    /// phases switching often, such as the serialization of small elements.
+    ///
+    /// The allocations made by operator new can be counted in each phase
+    /// too if the program is built with JITANA_ALLOC_STATS defined, which
+    /// replaces the global operator new and operator delete. The live bytes
+    /// of an input only count the memory allocated since it started, but
+    /// freeing the memory allocated before it subtracts from them down to
+    /// zero, which can hide as much of the memory of the input. The buffers
+    /// reused from the previous inputs are only counted when they grow.
+    class decode_stats {
+    public:
+        static constexpr size_t phase_count
+                = static_cast<size_t>(decode_phase::count);
+
+        /// The time spent in each phase in nanoseconds.
+        std::array<uint64_t, phase_count> phase_ns = {};
+
+        /// The numbers of the binary XML chunks keyed by the chunk type.
+        std::map<uint16_t, uint64_t> chunks;
+
+        uint64_t files = 0;
+        uint64_t strings = 0;
+        uint64_t elements = 0;
+        uint64_t attributes = 0;
+        uint64_t max_depth = 0;
+
+        /// The sizes of the documents parsed and the text XML written.
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+
+        /// The hardware events counted in each phase.
+        std::array<perf_counters::values, phase_count> phase_events = {};
+
+        /// True for the events counted in phase_events.
+        std::array<bool, perf_counters::event_count> events_counted = {};
+
+        /// Counts the hardware events from the next switch of the phases.
+        /// The counters are opened for the thread running the phases, and
+        /// only the time is measured if none can be opened.
+        void enable_counters()
+        {
+            counters_enabled_ = true;
+        }
+
+        /// Returns true if enable_counters() has been called.
+        bool counters_enabled() const
+        {
+            return counters_enabled_;
+        }
+
+        /// The heap allocations made in each phase.
+        std::array<alloc_counts, phase_count> phase_allocs = {};
+
+        /// The largest peak of the live bytes of an input.
+        uint64_t peak_live_bytes = 0;
+
+        /// The peak resident set size of the process, set by the caller if
+        /// known.
+        uint64_t peak_rss = 0;
+
+        /// Counts the allocations from the next input. An input starts when
+        /// a phase starts with none running, and ends when none is running
+        /// again.
+        void enable_alloc_tracking()
+        {
+            allocs_enabled_ = true;
+        }
+
+        /// Returns true if enable_alloc_tracking() has been called.
+        bool alloc_tracking_enabled() const
+        {
+            return allocs_enabled_;
+        }
+
+        /// Returns true if the allocations can be counted in this build.
+        static bool alloc_tracking_available();
+
+        /// Returns the peak of the live bytes of the last input.
+        uint64_t last_peak_live_bytes() const
+        {
+            return input_peak_;
+        }
+
+        /// Counts an allocation or a deallocation of the size. Called by
+        /// operator new and operator delete.
+        void count_allocation(size_t size);
+        void count_deallocation(size_t size);
+
+        /// Adds the statistics of another.
+        void merge(const decode_stats& x);
+
+        /// Writes the statistics for people to read.
+        void write_text(std::ostream& os) const;
+
+        /// Writes the statistics as a JSON object.
+        void write_json(std::ostream& os) const;
+
+        /// Makes the phase the running one, and returns the phase running
+        /// before. Use phase_timer instead of calling this directly.
+        decode_phase switch_phase(decode_phase phase);
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        void switch_counters();
+        void switch_allocs(decode_phase phase);
+        void write_allocs_text(std::ostream& os) const;
+
+        /// The running phase, or decode_phase::count if none.
+        decode_phase running_ = decode_phase::count;
+        clock::time_point running_since_;
+
+        bool counters_enabled_ = false;
+        std::unique_ptr<perf_counters> counters_;
+        perf_counters::values counters_since_ = {};
+
+        bool allocs_enabled_ = false;
+        uint64_t live_ = 0;
+        uint64_t input_peak_ = 0;
+    };
+
+    /// Attributes the time in the scope to the phase. Does nothing if the
+    /// statistics are null.
+    class phase_timer {
+    public:
+        phase_timer(decode_stats* stats, decode_phase phase) : stats_(stats)
+        {
+            if (stats_) {
+                previous_ = stats_->switch_phase(phase);
+            }
+        }
+
+        ~phase_timer()
+        {
+            if (stats_) {
+                stats_->switch_phase(previous_);
+            }
+        }
+
+        phase_timer(const phase_timer&) = delete;
+        phase_timer& operator=(const phase_timer&) = delete;
+
+    private:
+        decode_stats* stats_;
+        decode_phase previous_ = decode_phase::count;
+    };
+
+    /// A handler passing the callbacks to another and attributing the time
+    /// spent there to serialization.
+    class timed_handler : public axml_handler {
+    public:
+        timed_handler(axml_handler& handler, decode_stats& stats)
+                : handler_(handler), stats_(stats)
+        {
+        }
+
+        void start_document() override;
+        void end_document() override;
+        void start_namespace(boost::string_ref prefix,
+                             boost::string_ref uri) override;
+        void end_namespace(boost::string_ref prefix,
+                           boost::string_ref uri) override;
+        void start_element(boost::string_ref name) override;
+        void attribute(boost::string_ref name,
+                       boost::string_ref value) override;
+        void end_element(boost::string_ref name) override;
+        void cdata(boost::string_ref text) override;
+
+    private:
+        axml_handler& handler_;
+        decode_stats& stats_;
+    };
+}
+
+#endif
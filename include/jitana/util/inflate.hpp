@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_INFLATE_HPP
+#define JITANA_INFLATE_HPP
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace jitana {
+    struct inflate_error : std::runtime_error {
+        using runtime_error::runtime_error;
+    };
+
+    /// The implementations inflate_raw() can use.
+    ///
+    /// libdeflate is available only if it is found at build time
+    /// (JITANA_HAVE_LIBDEFLATE). zlib is always available.
+    enum class inflate_backend { zlib, libdeflate };
+
+    /// Returns the fastest backend available.
+    inflate_backend inflate_best_backend();
+
+    /// Returns true if the backend is available.
+    bool inflate_backend_available(inflate_backend backend);
+
+    /// Inflates the raw deflate stream in one call using the fastest
+    /// backend. The size of the output buffer must be exactly the
+    /// uncompressed size.
+    ///
+    /// The decompressor state is kept per thread and reused across calls.
+    void inflate_raw(const void* in, size_t in_size, void* out,
+                     size_t out_size);
+
+    /// Inflates the raw deflate stream in one call using the specified
+    /// backend. An unavailable backend falls back to zlib.
+    void inflate_raw(const void* in, size_t in_size, void* out,
+                     size_t out_size, inflate_backend backend);
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef JITANA_PERF_COUNTERS_HPP
+#define JITANA_PERF_COUNTERS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace jitana {
+    /// The hardware events counted by perf_counters.
+    enum class perf_event {
+        cycles,
+        instructions,
+        branch_misses,
+        cache_misses,
+
+        /// Not an event; the number of the events.
+        count
+    };
+
+    /// Returns the name of the event.
+    const char* perf_event_name(perf_event event);
+
+    /// The hardware performance counters of the calling thread, read with
+    /// perf_event_open(2) on Linux.
+    ///
+    /// The counters only count in the user space, so the system calls made
+    /// to read them are mostly left out. The events the CPU or the kernel
+    /// cannot count, due to virtualization or perf_event_paranoid for
+    /// example, are left out; on other systems none are counted.
+    class perf_counters {
+    public:
+        static constexpr size_t event_count
+                = static_cast<size_t>(perf_event::count);
+        using values = std::array<uint64_t, event_count>;
+
+        /// Opens and starts the counters for the calling thread.
+        perf_counters();
+
+        ~perf_counters();
+
+        perf_counters(const perf_counters&) = delete;
+        perf_counters& operator=(const perf_counters&) = delete;
+
+        /// Returns true if any of the events is counted.
+        bool available() const
+        {
+            return group_ >= 0;
+        }
+
+        /// Returns true if the event is counted.
+        bool counts(perf_event event) const
+        {
+            return slots_[static_cast<size_t>(event)] >= 0;
+        }
+
+        /// Reads the counts of the events so far. The ones not counted are
+        /// zero.
+        void read(values& v) const;
+
+    private:
+        /// The file descriptors of the events. The first one opened leads
+        /// the group, so that all are read at once.
+        int group_ = -1;
+        std::array<int, event_count> fds_;
+
+        /// The positions of the events in the values read from the group,
+        /// or -1 for the ones not counted.
+        std::array<int, event_count> slots_;
+        size_t slot_count_ = 0;
+    };
+}
+
+#endif
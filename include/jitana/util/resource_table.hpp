@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_RESOURCE_TABLE_HPP
+#define JITANA_RESOURCE_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace jitana {
+    struct resource_table_error : std::runtime_error {
+        using runtime_error::runtime_error;
+    };
+
+    /// The name of a resource: @package:type/entry.
+    struct resource_name {
+        std::string package;
+        std::string type;
+        std::string entry;
+    };
+
+    /// A compiled resource table (resources.arsc) in memory.
+    ///
+    /// Opening the table only indexes where the packages, the string pools,
+    /// and the type chunks are. The entries and the strings are decoded when
+    /// they are looked up, so a large table opens quickly and costs little
+    /// memory. The lookups do not modify the table, so they can be made from
+    /// multiple threads.
+    ///
+    /// When a resource has multiple configurations, the default one is
+    /// preferred.
+    class resource_table {
+    public:
+        /// Opens the resource table file by mapping it into memory.
+        explicit resource_table(const std::string& filename);
+
+        /// Opens the resource table in the memory range. The memory must
+        /// outlive the table.
+        resource_table(const void* first, const void* last);
+
+        /// Opens the resource table in the buffer taken over.
+        explicit resource_table(std::vector<char> content);
+
+        resource_table(const resource_table&) = delete;
+        resource_table& operator=(const resource_table&) = delete;
+
+        /// Finds the name of the resource. Returns false if there is no such
+        /// resource.
+        bool find_name(uint32_t id, resource_name& name) const;
+
+        /// Finds the value of the resource as in Res_value. Returns false if
+        /// there is no such resource or if it is a bag (style, array,
+        /// etc.).
+        bool find_value(uint32_t id, uint8_t& data_type, uint32_t& data) const;
+
+        /// Returns the string in the global string pool, which is referenced
+        /// by the values of the string type.
+        std::string value_string(uint32_t index) const;
+
+        /// Appends the reference to the resource in the XML form such as
+        /// "@string/app_name" or "?android:attr/colorPrimary". The package
+        /// name is omitted for the first package in the table. Returns false
+        /// without appending anything if the resource is unknown.
+        bool format_reference(uint32_t id, char prefix, std::string& out) const;
+
+    private:
+        /// The index of a package. The offsets are from the beginning of the
+        /// table.
+        struct package_info {
+            uint32_t id;
+            std::string name;
+            uint32_t type_strings;
+            uint32_t key_strings;
+            uint32_t type_id_offset;
+
+            /// The offsets of the type chunks of each type ID minus one.
+            /// The default configuration comes first.
+            std::vector<std::vector<uint32_t>> types;
+        };
+
+        /// The entry of a resource in a type chunk.
+        struct entry_ref {
+            const package_info* package;
+            uint32_t key;
+            uint16_t flags;
+            uint8_t data_type;
+            uint32_t data;
+        };
+
+        void read_table();
+        void read_package(uint32_t offset, uint32_t size);
+        const package_info* find_package(uint32_t id) const;
+        bool find_entry(uint32_t id, entry_ref& ref) const;
+        bool read_entry(uint32_t chunk, uint32_t index, entry_ref& ref) const;
+        std::string read_string(uint32_t pool, uint32_t index) const;
+
+    private:
+        boost::iostreams::mapped_file_source file_;
+        std::vector<char> content_;
+        const uint8_t* first_;
+        const uint8_t* last_;
+
+        /// The offset of the global string pool, or zero if there is none.
+        uint32_t value_strings_ = 0;
+
+        std::vector<package_info> packages_;
+    };
+}
+
+#endif
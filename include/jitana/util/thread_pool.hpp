@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_THREAD_POOL_HPP
+#define JITANA_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jitana {
+    /// A fixed number of worker threads running the posted tasks.
+    ///
+    /// Each worker has its own queue. The tasks posted from outside are
+    /// spread over the queues in turn, and the ones posted from a worker go
+    /// to its own queue. A worker whose queue is empty steals from the back
+    /// of the others, so the load stays balanced without a single queue
+    /// contended by all the workers. The tasks are counted with atomics,
+    /// and the lock of the pool is only taken to put the idle workers to
+    /// sleep and to wake them up.
+    ///
+    /// Each task receives the index of the worker running it, so that the
+    /// caller can keep the state of each worker, such as a parser, without
+    /// locking.
+    class thread_pool {
+    public:
+        using task = std::function<void(size_t worker)>;
+
+        /// Starts the workers. Zero means the number of the hardware
+        /// threads.
+        explicit thread_pool(size_t size = 0);
+
+        /// Waits for the tasks and stops the workers.
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        /// Returns the number of the workers.
+        size_t size() const
+        {
+            return workers_.size();
+        }
+
+        /// Adds the task to a queue.
+        void post(task t);
+
+        /// Waits until all the tasks posted are finished. If any of them
+        /// threw an exception, the first one is rethrown.
+        void wait();
+
+    private:
+        struct worker_queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        bool claim();
+        bool claim_soon();
+        bool pop(size_t worker, task& t);
+        void run(size_t worker);
+
+    private:
+        std::vector<std::thread> workers_;
+        std::vector<std::unique_ptr<worker_queue>> queues_;
+        std::atomic<size_t> next_queue_{0};
+
+        /// The number of the tasks in the queues not claimed by a worker
+        /// yet. It is incremented after a task is pushed, so a worker
+        /// claiming one always finds a task in a queue.
+        std::atomic<size_t> queued_{0};
+
+        /// The number of the tasks not finished yet.
+        std::atomic<size_t> pending_{0};
+
+        /// The number of the workers sleeping or about to sleep.
+        std::atomic<size_t> sleepers_{0};
+
+        /// Guards stopping_ and error_, and the sleeping of the workers.
+        std::mutex mutex_;
+        std::condition_variable task_posted_;
+        std::condition_variable tasks_done_;
+        bool stopping_ = false;
+        std::exception_ptr error_;
+    };
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_UTF16_HPP
+#define JITANA_UTF16_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jitana {
+    /// The instruction sets utf16_to_utf8() can use.
+    enum class utf16_isa { scalar, sse2, avx2 };
+
+    /// Returns the best instruction set supported by the running CPU.
+    utf16_isa utf16_best_isa();
+
+    /// Returns the maximum number of bytes needed to convert the specified
+    /// number of UTF-16 code units to UTF-8.
+    inline size_t utf16_to_utf8_max_size(size_t size)
+    {
+        return size * 3;
+    }
+
+    /// Converts the UTF-16 string to UTF-8 using the best instruction set.
+    ///
+    /// The output buffer must have at least utf16_to_utf8_max_size() bytes.
+    /// Invalid surrogates are skipped in the same way as
+    /// boost::locale::conv::utf_to_utf(). Returns the number of bytes
+    /// written.
+    size_t utf16_to_utf8(const uint16_t* first, const uint16_t* last,
+                         char* out);
+
+    /// Converts the UTF-16 string to UTF-8 using the specified instruction
+    /// set. An instruction set unsupported by the CPU falls back to the best
+    /// supported one.
+    size_t utf16_to_utf8(const uint16_t* first, const uint16_t* last,
+                         char* out, utf16_isa isa);
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_XML_WRITER_HPP
+#define JITANA_XML_WRITER_HPP
+
+#include "jitana/util/axml_parser.hpp"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jitana {
+    /// A handler writing the binary XML as indented text XML without building
+    /// an intermediate tree.
+    ///
+    /// The output is identical to what boost::property_tree::write_xml()
+    /// produces for the tree filled by read_axml() with the same indentation
+    /// settings. Only the open elements are kept, so the memory usage is
+    /// proportional to the depth of the document.
+    class xml_writer : public axml_handler {
+    public:
+        /// Creates a xml_writer instance writing to the stream.
+        explicit xml_writer(std::ostream& os, char indent_char = ' ',
+                            int indent_count = 2);
+
+        void start_document() override;
+        void end_document() override;
+        void start_namespace(boost::string_ref prefix,
+                             boost::string_ref uri) override;
+        void end_namespace(boost::string_ref prefix,
+                           boost::string_ref uri) override;
+        void start_element(boost::string_ref name) override;
+        void attribute(boost::string_ref name,
+                       boost::string_ref value) override;
+        void end_element(boost::string_ref name) override;
+        void cdata(boost::string_ref text) override;
+
+        /// Writes the buffered output to the stream.
+        void flush();
+
+        /// Returns the number of the bytes written so far including the
+        /// buffered ones.
+        size_t bytes_written() const
+        {
+            return flushed_size_ + buffer_.size();
+        }
+
+    private:
+        struct element_state {
+            size_t name_offset;
+            size_t namespace_offset;
+            bool has_elements;
+        };
+
+        void write_indent(int indent);
+        void write_encoded(boost::string_ref s);
+        void write_newline();
+        void flush_if_full();
+
+    private:
+        std::ostream& os_;
+        char indent_char_;
+        int indent_count_;
+
+        std::string buffer_;
+        size_t flushed_size_ = 0;
+
+        /// The open elements. The names are packed in names_.
+        std::vector<element_state> stack_;
+        std::string names_;
+
+        /// The namespaces declared in the open elements. Each element owns
+        /// the ones after its namespace_offset.
+        std::vector<std::pair<std::string, std::string>> namespaces_;
+
+        /// The character data of the innermost element waiting until it is
+        /// known whether the element has child elements.
+        std::string pending_text_;
+        std::vector<size_t> pending_text_ends_;
+    };
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef JITANA_ZIP_ARCHIVE_HPP
+#define JITANA_ZIP_ARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace jitana {
+    struct zip_archive_error : std::runtime_error {
+        using runtime_error::runtime_error;
+    };
+
+    /// A read-only ZIP archive in memory.
+    ///
+    /// The central directory is read once when the archive is opened, and the
+    /// entries are looked up by name through a hash table. The names and the
+    /// data of the entries point into the memory of the archive, so they are
+    /// valid as long as the archive is alive. ZIP64 archives are supported,
+    /// but encrypted and multi-disk ones are not.
+    class zip_archive {
+    public:
+        static constexpr uint16_t method_stored = 0;
+        static constexpr uint16_t method_deflated = 8;
+        static constexpr uint16_t flag_encrypted = 0x0001;
+
+        struct entry {
+            boost::string_ref name;
+            uint16_t flags;
+            uint16_t method;
+            uint32_t crc32;
+            uint64_t compressed_size;
+            uint64_t uncompressed_size;
+            uint64_t local_header_offset;
+
+            /// Returns true if the content is stored as is without
+            /// compression or encryption.
+            bool is_stored() const
+            {
+                return method == method_stored && !(flags & flag_encrypted);
+            }
+        };
+
+        /// Opens the ZIP file by mapping it into memory.
+        explicit zip_archive(const std::string& filename);
+
+        /// Opens the ZIP archive in the memory range. The memory must
+        /// outlive the archive.
+        zip_archive(const void* first, const void* last);
+
+        zip_archive(const zip_archive&) = delete;
+        zip_archive& operator=(const zip_archive&) = delete;
+
+        /// Returns the entries in the order of the central directory.
+        const std::vector<entry>& entries() const
+        {
+            return entries_;
+        }
+
+        /// Returns the first entry with the name, or nullptr if there is
+        /// none.
+        const entry* find(boost::string_ref name) const;
+
+        /// Returns the data of the entry as stored in the archive without
+        /// copying. It is the content itself if is_stored() is true, but the
+        /// CRC-32 is not verified.
+        boost::string_ref raw_data(const entry& e) const;
+
+        /// Returns the uncompressed content of the entry. The CRC-32 is
+        /// verified.
+        std::vector<char> extract(const entry& e) const;
+
+        /// Replaces the content of the vector with the uncompressed content
+        /// of the entry, reusing its memory. The CRC-32 is verified.
+        void extract(const entry& e, std::vector<char>& content) const;
+
+        /// Passes the uncompressed content of the entry to the function in
+        /// pieces as it is inflated, so that the content can be processed
+        /// without holding all of it. The CRC-32 is verified at the end.
+        void extract(const entry& e,
+                     const std::function<void(const char*, size_t)>& f) const;
+
+    private:
+        boost::string_ref checked_data(const entry& e) const;
+        void read_central_directory();
+        void build_index();
+
+    private:
+        boost::iostreams::mapped_file_source file_;
+        const char* first_;
+        const char* last_;
+
+        std::vector<entry> entries_;
+
+        /// The open addressing hash table of the entry indices plus one. Zero
+        /// means an empty slot.
+        std::vector<uint32_t> index_;
+    };
+}
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/android_attrs.hpp"
+
+#include <cstddef>
+
+using namespace jitana;
+
+namespace {
+    struct attr_entry {
+        uint32_t id;
+        const char* name;
+    };
+
+    constexpr attr_entry attrs[] = {
+#define JITANA_ANDROID_ATTR(id, name) {id, name},
+#include "android_attrs.inc"
+#undef JITANA_ANDROID_ATTR
+    };
+
+    constexpr size_t attr_count = sizeof(attrs) / sizeof(attrs[0]);
+    constexpr uint32_t first_id = attrs[0].id;
+    constexpr uint32_t last_id = attrs[attr_count - 1].id;
+
+    constexpr bool is_sorted()
+    {
+        for (size_t i = 1; i < attr_count; ++i) {
+            if (attrs[i - 1].id >= attrs[i].id) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(is_sorted(), "the attributes must be sorted by ID");
+
+    constexpr size_t c_str_length(const char* s)
+    {
+        size_t n = 0;
+        while (s[n] != '\0') {
+            ++n;
+        }
+        return n;
+    }
+
+    constexpr bool c_str_equal(const char* a, const char* b)
+    {
+        for (; *a != '\0' && *a == *b; ++a, ++b) {
+        }
+        return *a == *b;
+    }
+
+    /// Computes the FNV-1a hash of the name.
+    constexpr uint32_t hash_name(const char* s, size_t n)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; ++i) {
+            h = (h ^ static_cast<uint8_t>(s[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    /// The table mapping (ID - first_id) to the index in attrs. The IDs that
+    /// are not listed map to -1.
+    struct id_table {
+        int16_t slots[last_id - first_id + 1];
+    };
+
+    constexpr id_table make_id_table()
+    {
+        id_table t{};
+        for (auto& s : t.slots) {
+            s = -1;
+        }
+        for (size_t i = 0; i < attr_count; ++i) {
+            t.slots[attrs[i].id - first_id] = static_cast<int16_t>(i);
+        }
+        return t;
+    }
+
+    constexpr id_table by_id = make_id_table();
+
+    /// The open addressing hash table mapping the names to the indices in
+    /// attrs. It is kept at most half full so that the probes are short.
+    constexpr size_t name_slot_count = 4096;
+    constexpr size_t name_slot_mask = name_slot_count - 1;
+    static_assert(name_slot_count >= attr_count * 2,
+                  "the name table is too small");
+
+    struct name_table {
+        int16_t slots[name_slot_count];
+        bool has_duplicates;
+    };
+
+    constexpr name_table make_name_table()
+    {
+        name_table t{};
+        for (auto& s : t.slots) {
+            s = -1;
+        }
+        for (size_t i = 0; i < attr_count; ++i) {
+            const auto* name = attrs[i].name;
+            auto h = hash_name(name, c_str_length(name)) & name_slot_mask;
+            while (t.slots[h] != -1) {
+                if (c_str_equal(attrs[t.slots[h]].name, name)) {
+                    t.has_duplicates = true;
+                }
+                h = (h + 1) & name_slot_mask;
+            }
+            t.slots[h] = static_cast<int16_t>(i);
+        }
+        return t;
+    }
+
+    constexpr name_table by_name = make_name_table();
+    static_assert(!by_name.has_duplicates, "the attribute names must be unique");
+
+    /// The attributes of the string format in attrs.xml and
+    /// attrs_manifest.xml. Their values stay strings even if they look like
+    /// numbers or booleans, such as android:versionName="1".
+    constexpr const char* string_attr_names[] = {
+            "appComponentFactory",
+            "authorities",
+            "backupAgent",
+            "certDigest",
+            "compileSdkVersionCodename",
+            "contentDescription",
+            "hint",
+            "host",
+            "label",
+            "manageSpaceActivity",
+            "mimeGroup",
+            "mimeType",
+            "name",
+            "parentActivityName",
+            "path",
+            "pathPattern",
+            "pathPrefix",
+            "permission",
+            "permissionGroup",
+            "port",
+            "process",
+            "readPermission",
+            "requiredAccountType",
+            "requiredFeature",
+            "requiredNotFeature",
+            "requiredSystemPropertyName",
+            "requiredSystemPropertyValue",
+            "restrictedAccountType",
+            "scheme",
+            "sharedUserId",
+            "splitName",
+            "ssp",
+            "sspPattern",
+            "sspPrefix",
+            "targetActivity",
+            "targetClass",
+            "targetPackage",
+            "targetProcesses",
+            "taskAffinity",
+            "text",
+            "tooltipText",
+            "versionName",
+            "writePermission",
+            "zygotePreloadName",
+    };
+
+    /// The table mapping (ID - first_id) to whether the attribute is of the
+    /// string format.
+    struct string_table {
+        bool slots[last_id - first_id + 1];
+        bool has_unknown;
+    };
+
+    constexpr string_table make_string_table()
+    {
+        string_table t{};
+        for (const auto* name : string_attr_names) {
+            size_t i = 0;
+            while (i < attr_count && !c_str_equal(attrs[i].name, name)) {
+                ++i;
+            }
+            if (i == attr_count) {
+                t.has_unknown = true;
+                continue;
+            }
+            t.slots[attrs[i].id - first_id] = true;
+        }
+        return t;
+    }
+
+    constexpr string_table string_attrs = make_string_table();
+    static_assert(!string_attrs.has_unknown,
+                  "the string attributes must be in the attribute table");
+}
+
+const char* jitana::android_attr_name(uint32_t id)
+{
+    if (id < first_id || id > last_id) {
+        return nullptr;
+    }
+
+    auto i = by_id.slots[id - first_id];
+    return i < 0 ? nullptr : attrs[i].name;
+}
+
+uint32_t jitana::android_attr_id(boost::string_ref name)
+{
+    auto h = hash_name(name.data(), name.size()) & name_slot_mask;
+    for (;; h = (h + 1) & name_slot_mask) {
+        auto i = by_name.slots[h];
+        if (i < 0) {
+            return 0;
+        }
+        if (name == boost::string_ref(attrs[i].name)) {
+            return attrs[i].id;
+        }
+    }
+}
+
+bool jitana::android_attr_is_string(uint32_t id)
+{
+    return id >= first_id && id <= last_id && string_attrs.slots[id - first_id];
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/axml_document.hpp"
+
+#include <boost/functional/hash.hpp>
+
+using namespace jitana;
+
+axml_document::axml_document()
+{
+    clear();
+}
+
+axml_document::node axml_document::root_element() const
+{
+    for (auto child : root().children()) {
+        if (child.is_element()) {
+            return child;
+        }
+    }
+    return root();
+}
+
+size_t axml_document::memory_usage() const
+{
+    return sizeof(*this) + nodes_.capacity() * sizeof(node_data)
+            + attributes_.capacity() * sizeof(attribute_data)
+            + strings_.capacity() * sizeof(string_data) + chars_.capacity();
+}
+
+void axml_document::clear()
+{
+    // Swap with empty containers to release the memory.
+    std::vector<node_data>().swap(nodes_);
+    std::vector<attribute_data>().swap(attributes_);
+    std::vector<string_data>().swap(strings_);
+    std::string().swap(chars_);
+
+    // The string 0 is the empty string, and the node 0 is the document.
+    strings_.push_back({0, 0});
+    nodes_.push_back({node_kind::document, 0, 0, 1, 0, 0});
+}
+
+boost::optional<boost::string_ref>
+axml_document::node::find_attribute(boost::string_ref name) const
+{
+    for (auto attr : attributes()) {
+        if (attr.name() == name) {
+            return attr.value();
+        }
+    }
+    return boost::none;
+}
+
+boost::optional<axml_document::node>
+axml_document::node::find_child(boost::string_ref name) const
+{
+    for (auto child : children()) {
+        if (child.is_element() && child.name() == name) {
+            return child;
+        }
+    }
+    return boost::none;
+}
+
+size_t axml_document::builder::string_hash::operator()(uint32_t idx) const
+{
+    auto s = doc->string(idx);
+    return boost::hash_range(s.begin(), s.end());
+}
+
+bool axml_document::builder::string_equal::operator()(uint32_t x,
+                                                      uint32_t y) const
+{
+    return doc->string(x) == doc->string(y);
+}
+
+axml_document::builder::builder(axml_document& doc)
+        : doc_(doc), table_(0, string_hash{&doc}, string_equal{&doc})
+{
+}
+
+void axml_document::builder::start_document()
+{
+    doc_.clear();
+    stack_.clear();
+    namespaces_.clear();
+    table_.clear();
+    table_.insert(0);
+
+    stack_.emplace_back(0, 0);
+}
+
+void axml_document::builder::end_document()
+{
+    // Close the nodes left open by a truncated document.
+    while (!stack_.empty()) {
+        end_node();
+    }
+
+    // The document is not going to grow anymore.
+    doc_.nodes_.shrink_to_fit();
+    doc_.attributes_.shrink_to_fit();
+    doc_.strings_.shrink_to_fit();
+    doc_.chars_.shrink_to_fit();
+    table_.clear();
+}
+
+void axml_document::builder::start_namespace(boost::string_ref prefix,
+                                             boost::string_ref uri)
+{
+    scratch_.assign("xmlns:");
+    scratch_.append(prefix.data(), prefix.size());
+    auto name = intern(scratch_);
+    namespaces_.emplace_back(name, intern(uri));
+}
+
+void axml_document::builder::end_namespace(boost::string_ref /*prefix*/,
+                                           boost::string_ref /*uri*/)
+{
+    if (namespaces_.size() > stack_.back().second) {
+        namespaces_.pop_back();
+    }
+}
+
+void axml_document::builder::start_element(boost::string_ref name)
+{
+    auto namespace_offset = stack_.back().second;
+    start_node(node_kind::element, intern(name));
+
+    // The namespaces declared in the parent become the attributes.
+    auto& elem = doc_.nodes_.back();
+    for (size_t i = namespace_offset; i < namespaces_.size(); ++i) {
+        doc_.attributes_.push_back({namespaces_[i].first,
+                                    namespaces_[i].second});
+    }
+    elem.attr_last = static_cast<uint32_t>(doc_.attributes_.size());
+
+    stack_.emplace_back(static_cast<uint32_t>(doc_.nodes_.size() - 1),
+                        namespaces_.size());
+}
+
+void axml_document::builder::attribute(boost::string_ref name,
+                                       boost::string_ref value)
+{
+    auto name_idx = intern(name);
+    auto value_idx = intern(value);
+    doc_.attributes_.push_back({name_idx, value_idx});
+    doc_.nodes_[stack_.back().first].attr_last
+            = static_cast<uint32_t>(doc_.attributes_.size());
+}
+
+void axml_document::builder::end_element(boost::string_ref /*name*/)
+{
+    if (stack_.size() > 1) {
+        namespaces_.resize(stack_.back().second);
+        end_node();
+    }
+}
+
+void axml_document::builder::cdata(boost::string_ref text)
+{
+    start_node(node_kind::text, intern(text));
+}
+
+uint32_t axml_document::builder::intern(boost::string_ref s)
+{
+    auto& strings = doc_.strings_;
+    auto& chars = doc_.chars_;
+
+    // Add the string tentatively and remove it if it is already there.
+    auto idx = static_cast<uint32_t>(strings.size());
+    auto offset = static_cast<uint32_t>(chars.size());
+    chars.append(s.data(), s.size());
+    strings.push_back({offset, static_cast<uint32_t>(s.size())});
+
+    auto result = table_.insert(idx);
+    if (!result.second) {
+        strings.pop_back();
+        chars.resize(offset);
+    }
+    return *result.first;
+}
+
+void axml_document::builder::start_node(node_kind kind, uint32_t str)
+{
+    auto& nodes = doc_.nodes_;
+    auto idx = static_cast<uint32_t>(nodes.size());
+    auto attr = static_cast<uint32_t>(doc_.attributes_.size());
+    nodes.push_back({kind, str, stack_.back().first, idx + 1, attr, attr});
+}
+
+void axml_document::builder::end_node()
+{
+    doc_.nodes_[stack_.back().first].end
+            = static_cast<uint32_t>(doc_.nodes_.size());
+    stack_.pop_back();
+}
+
+void jitana::read_axml(const std::string& filename, axml_document& doc)
+{
+    axml_document::builder builder(doc);
+    read_axml(filename, builder);
+}
+
+void jitana::read_axml(std::istream& stream, axml_document& doc)
+{
+    axml_document::builder builder(doc);
+    read_axml(stream, builder);
+}
+
+void jitana::read_axml(const void* first, const void* last,
+                       axml_document& doc)
+{
+    axml_document::builder builder(doc);
+    read_axml(first, last, builder);
+}
+
+namespace {
+    using ptree = boost::property_tree::ptree;
+    using path_type = ptree::path_type;
+
+    /// Appends the child in the same way as ptree::add() with '`' as the
+    /// separator.
+    ptree& add_child(ptree& pt, boost::string_ref key, boost::string_ref data)
+    {
+        if (key.find('`') != boost::string_ref::npos) {
+            return pt.add(path_type(key.to_string(), '`'), data.to_string());
+        }
+        return pt.push_back({key.to_string(), ptree(data.to_string())})
+                ->second;
+    }
+
+    void add_children(axml_document::node n, ptree& pt)
+    {
+        for (auto child : n.children()) {
+            if (child.is_text()) {
+                pt.push_back({"<xmltext>", ptree(child.text().to_string())});
+                continue;
+            }
+
+            auto& elem_pt = add_child(pt, child.name(), "");
+            auto attrs = child.attributes();
+            if (!attrs.empty()) {
+                auto& attrs_pt
+                        = elem_pt.push_back({"<xmlattr>", ptree()})->second;
+                for (auto attr : attrs) {
+                    add_child(attrs_pt, attr.name(), attr.value());
+                }
+            }
+            add_children(child, elem_pt);
+        }
+    }
+}
+
+void jitana::to_ptree(const axml_document& doc,
+                      boost::property_tree::ptree& pt)
+{
+    add_children(doc.root(), pt);
+}
@@ -0,0 +1,779 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/axml_encoder.hpp"
+#include "jitana/util/android_attrs.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+#include <boost/locale/encoding_utf.hpp>
+
+using namespace jitana;
+
+namespace {
+    constexpr uint16_t res_string_pool_type = 0x0001;
+    constexpr uint16_t res_xml_type = 0x0003;
+    constexpr uint16_t res_xml_start_namespace_type = 0x0100;
+    constexpr uint16_t res_xml_end_namespace_type = 0x0101;
+    constexpr uint16_t res_xml_start_element_type = 0x0102;
+    constexpr uint16_t res_xml_end_element_type = 0x0103;
+    constexpr uint16_t res_xml_cdata_type = 0x0104;
+    constexpr uint16_t res_xml_resource_map_type = 0x0180;
+
+    constexpr uint8_t type_string = 0x03;
+    constexpr uint8_t type_dimension = 0x05;
+    constexpr uint8_t type_fraction = 0x06;
+    constexpr uint8_t type_int_dec = 0x10;
+    constexpr uint8_t type_int_hex = 0x11;
+    constexpr uint8_t type_int_boolean = 0x12;
+    constexpr uint8_t type_int_color_argb8 = 0x1c;
+    constexpr uint8_t type_int_color_rgb8 = 0x1d;
+    constexpr uint8_t type_int_color_argb4 = 0x1e;
+    constexpr uint8_t type_int_color_rgb4 = 0x1f;
+
+    constexpr char android_uri[] = "http://schemas.android.com/apk/res/android";
+
+    void put16(std::vector<char>& out, uint16_t x)
+    {
+        out.push_back(static_cast<char>(x));
+        out.push_back(static_cast<char>(x >> 8));
+    }
+
+    void put32(std::vector<char>& out, uint32_t x)
+    {
+        put16(out, static_cast<uint16_t>(x));
+        put16(out, static_cast<uint16_t>(x >> 16));
+    }
+
+    void set32(std::vector<char>& out, size_t pos, uint32_t x)
+    {
+        for (int i = 0; i < 4; ++i) {
+            out[pos + i] = static_cast<char>(x >> (8 * i));
+        }
+    }
+
+    void put_chunk_header(std::vector<char>& out, uint16_t type,
+                          uint16_t header_size, uint32_t size)
+    {
+        put16(out, type);
+        put16(out, header_size);
+        put32(out, size);
+    }
+
+    int hex_digit(char c)
+    {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool parse_hex(boost::string_ref s, uint32_t& x)
+    {
+        if (s.empty() || s.size() > 8) {
+            return false;
+        }
+        x = 0;
+        for (auto c : s) {
+            const auto d = hex_digit(c);
+            if (d < 0) {
+                return false;
+            }
+            x = (x << 4) | d;
+        }
+        return true;
+    }
+
+    /// Parses the decimal integer. Both the signed and the unsigned 32-bit
+    /// integers are accepted since the decoder prints them unsigned.
+    bool parse_dec(boost::string_ref s, uint32_t& x)
+    {
+        const bool neg = !s.empty() && s.front() == '-';
+        if (neg) {
+            s.remove_prefix(1);
+        }
+        if (s.empty() || s.size() > 10) {
+            return false;
+        }
+        uint64_t n = 0;
+        for (auto c : s) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            n = n * 10 + (c - '0');
+        }
+        if (n > (neg ? 0x80000000u : 0xffffffffu)) {
+            return false;
+        }
+        x = static_cast<uint32_t>(neg ? 0 - n : n);
+        return true;
+    }
+
+    /// Converts the number to the complex format of the dimensions and the
+    /// fractions with the most precise radix like aapt. The mantissa is
+    /// rounded to the nearest instead of truncated so that the values
+    /// printed by the decoder are encoded back to the same.
+    bool float_to_complex(double f, uint32_t unit, uint32_t& data)
+    {
+        // The radixes from 0p23 to 23p0 with the positions of the point.
+        static const struct {
+            uint32_t radix;
+            int shift;
+        } radixes[] = {{3, 0}, {2, 8}, {1, 16}, {0, 23}};
+
+        const bool neg = f < 0;
+        if (neg) {
+            f = -f;
+        }
+        if (!(f < (1 << 23))) {
+            return false;
+        }
+
+        const auto bits = static_cast<uint64_t>(f * (1 << 23) + 0.5);
+        for (const auto& r : radixes) {
+            const auto half = r.shift > 0 ? uint64_t(1) << (r.shift - 1) : 0;
+            auto mantissa = (bits + half) >> r.shift;
+            if ((bits & 0x7fffff) == 0 && r.shift != 23) {
+                // Integers are exact in 23p0.
+                continue;
+            }
+            if (mantissa > 0x7fffff) {
+                continue;
+            }
+            if (neg) {
+                mantissa = (0 - mantissa) & 0xffffff;
+            }
+            data = static_cast<uint32_t>(mantissa << 8) | (r.radix << 4)
+                    | unit;
+            return true;
+        }
+        return false;
+    }
+
+    struct complex_unit {
+        const char* suffix;
+        uint32_t unit;
+    };
+
+    /// Parses the number followed by one of the units, such as "16dip".
+    template <size_t N>
+    bool parse_complex(boost::string_ref s, const complex_unit (&units)[N],
+                       double scale, uint32_t& data)
+    {
+        // Find the end of the number.
+        size_t i = 0;
+        auto skip_digits = [&] {
+            const auto start = i;
+            while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+                ++i;
+            }
+            return i - start;
+        };
+        if (i < s.size() && (s[i] == '-' || s[i] == '+')) {
+            ++i;
+        }
+        auto digits = skip_digits();
+        if (i < s.size() && s[i] == '.') {
+            ++i;
+            digits += skip_digits();
+        }
+        if (digits == 0) {
+            return false;
+        }
+        if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+            ++i;
+            if (i < s.size() && (s[i] == '-' || s[i] == '+')) {
+                ++i;
+            }
+            if (skip_digits() == 0) {
+                return false;
+            }
+        }
+
+        const auto suffix = s.substr(i);
+        for (const auto& u : units) {
+            if (suffix == u.suffix) {
+                const std::string number(s.data(), i);
+                return float_to_complex(
+                        std::strtod(number.c_str(), nullptr) * scale, u.unit,
+                        data);
+            }
+        }
+        return false;
+    }
+
+    /// Encodes the attribute value as a typed value if it has the form of
+    /// one. Returns false if it should be a string. The values of the
+    /// attributes of the string format are only typed if they are in the
+    /// form the decoder prints the typed values without text forms in.
+    bool parse_typed_value(boost::string_ref s, bool string_format,
+                           uint8_t& type, uint32_t& data)
+    {
+        static const complex_unit dimension_units[]
+                = {{"px", 0}, {"dp", 1}, {"dip", 1}, {"sp", 2},
+                   {"pt", 3}, {"in", 4}, {"mm", 5}};
+        static const complex_unit fraction_units[] = {{"%", 0}, {"%p", 1}};
+
+        if (s.empty()) {
+            return false;
+        }
+
+        if (s.starts_with("type")) {
+            // The form the decoder prints the values having no text form
+            // in, such as the colors and the references without
+            // resources.arsc.
+            const auto slash = s.find('/');
+            uint32_t t;
+            if (slash != boost::string_ref::npos
+                && parse_dec(s.substr(4, slash - 4), t) && t <= 0xff
+                && t != type_string && parse_dec(s.substr(slash + 1), data)) {
+                type = static_cast<uint8_t>(t);
+                return true;
+            }
+            return false;
+        }
+
+        if (string_format) {
+            return false;
+        }
+
+        if (s == "true" || s == "false") {
+            type = type_int_boolean;
+            data = s == "true" ? 0xffffffff : 0;
+            return true;
+        }
+
+        if (s.front() == '#') {
+            // Expand the 4-bit channels and make the colors opaque unless
+            // the alpha is given.
+            uint32_t x;
+            if (!parse_hex(s.substr(1), x)) {
+                return false;
+            }
+            auto expand = [](uint32_t x) {
+                uint32_t y = 0;
+                for (int i = 3; i >= 0; --i) {
+                    const auto d = (x >> (4 * i)) & 0xf;
+                    y = (y << 8) | (d << 4) | d;
+                }
+                return y;
+            };
+            switch (s.size()) {
+            case 4:
+                type = type_int_color_rgb4;
+                data = 0xff000000 | expand(x);
+                return true;
+            case 5:
+                type = type_int_color_argb4;
+                data = expand(x);
+                return true;
+            case 7:
+                type = type_int_color_rgb8;
+                data = 0xff000000 | x;
+                return true;
+            case 9:
+                type = type_int_color_argb8;
+                data = x;
+                return true;
+            }
+            return false;
+        }
+
+        if (s.starts_with("0x") || s.starts_with("0X")) {
+            type = type_int_hex;
+            return parse_hex(s.substr(2), data);
+        }
+
+        if (parse_dec(s, data)) {
+            type = type_int_dec;
+            return true;
+        }
+
+        // Plain floating point numbers stay strings as aapt does for the
+        // attributes without formats, such as android:versionName.
+        if (parse_complex(s, dimension_units, 1, data)) {
+            type = type_dimension;
+            return true;
+        }
+        if (parse_complex(s, fraction_units, 0.01, data)) {
+            type = type_fraction;
+            return true;
+        }
+        return false;
+    }
+
+    /// Returns the resource ID of the attribute of the android namespace,
+    /// including the ones the decoder prints as attr_0x01010608 because the
+    /// table does not have them, or zero if it is unknown. The unknown ones
+    /// are kept without IDs as the binary XML files may have them.
+    uint32_t android_attr_resource_id(boost::string_ref name)
+    {
+        if (const auto id = android_attr_id(name)) {
+            return id;
+        }
+        uint32_t id;
+        if (name.size() == 15 && name.starts_with("attr_0x")
+            && parse_hex(name.substr(7), id)) {
+            return id;
+        }
+        return 0;
+    }
+
+    /// Returns true if the attribute without a namespace is one of the
+    /// manifest aapt writes as strings.
+    bool is_string_manifest_attribute(boost::string_ref name)
+    {
+        return name == "package" || name == "split"
+                || name == "platformBuildVersionName";
+    }
+
+    bool is_prefix_declaration(const std::string& name)
+    {
+        return name.compare(0, 6, "xmlns:") == 0;
+    }
+
+    /// Reports the element in the tree filled by read_xml() to the handler.
+    void write_element(const boost::property_tree::ptree& pt,
+                       const std::string& name, axml_handler& handler)
+    {
+        // The namespaces declared by the element come into scope before it.
+        std::vector<std::pair<std::string, const std::string*>> namespaces;
+        const auto attrs = pt.get_child_optional("<xmlattr>");
+        if (attrs) {
+            for (const auto& a : *attrs) {
+                if (a.first == "xmlns") {
+                    namespaces.emplace_back("", &a.second.data());
+                }
+                else if (is_prefix_declaration(a.first)) {
+                    namespaces.emplace_back(a.first.substr(6),
+                                            &a.second.data());
+                }
+            }
+        }
+        for (const auto& ns : namespaces) {
+            handler.start_namespace(ns.first, *ns.second);
+        }
+
+        handler.start_element(name);
+        if (attrs) {
+            for (const auto& a : *attrs) {
+                if (a.first != "xmlns" && !is_prefix_declaration(a.first)) {
+                    handler.attribute(a.first, a.second.data());
+                }
+            }
+        }
+        if (!pt.data().empty()) {
+            handler.cdata(pt.data());
+        }
+        for (const auto& child : pt) {
+            if (child.first == "<xmltext>") {
+                handler.cdata(child.second.data());
+            }
+            else if (child.first != "<xmlattr>"
+                     && child.first != "<xmlcomment>") {
+                write_element(child.second, child.first, handler);
+            }
+        }
+        handler.end_element(name);
+
+        for (auto it = namespaces.rbegin(); it != namespaces.rend(); ++it) {
+            handler.end_namespace(it->first, *it->second);
+        }
+    }
+}
+
+constexpr uint32_t axml_encoder::no_string;
+constexpr uint32_t axml_encoder::mapped_flag;
+
+axml_encoder::axml_encoder(bool utf8) : utf8_(utf8)
+{
+}
+
+void axml_encoder::start_document()
+{
+    // Keep the capacities for encoding many documents.
+    strings_.clear();
+    string_indices_.clear();
+    mapped_names_.clear();
+    mapped_name_indices_.clear();
+    nodes_.clear();
+    attributes_.clear();
+    in_start_element_ = false;
+    namespaces_.clear();
+    data_.clear();
+}
+
+void axml_encoder::end_document()
+{
+    close_start_element();
+
+    // The attribute names with the resource IDs come first in the order of
+    // the IDs so that they match the resource map.
+    std::vector<uint32_t> mapped_order(mapped_names_.size());
+    std::iota(begin(mapped_order), end(mapped_order), 0);
+    std::sort(begin(mapped_order), end(mapped_order),
+              [&](uint32_t a, uint32_t b) {
+                  return mapped_names_[a].first < mapped_names_[b].first;
+              });
+    std::vector<uint32_t> mapped_indices(mapped_names_.size());
+    for (size_t i = 0; i < mapped_order.size(); ++i) {
+        mapped_indices[mapped_order[i]] = static_cast<uint32_t>(i);
+    }
+    const auto mapped_count = static_cast<uint32_t>(mapped_names_.size());
+    auto ref = [&](uint32_t index) {
+        if (index == no_string) {
+            return index;
+        }
+        if (index & mapped_flag) {
+            return mapped_indices[index & ~mapped_flag];
+        }
+        return mapped_count + index;
+    };
+
+    data_.clear();
+    data_.reserve(64 * nodes_.size() + 20 * attributes_.size());
+    put_chunk_header(data_, res_xml_type, 8, 0);
+    write_string_pool(mapped_order);
+
+    if (!mapped_order.empty()) {
+        put_chunk_header(data_, res_xml_resource_map_type, 8,
+                         static_cast<uint32_t>(8 + 4 * mapped_order.size()));
+        for (auto i : mapped_order) {
+            put32(data_, mapped_names_[i].first);
+        }
+    }
+
+    uint32_t line = 0;
+    for (const auto& n : nodes_) {
+        auto put_node_header = [&](uint32_t size) {
+            put_chunk_header(data_, n.type, 16, size);
+            put32(data_, ++line);
+            put32(data_, no_string);
+        };
+
+        switch (n.type) {
+        case res_xml_start_element_type: {
+            const auto first = begin(attributes_) + n.first_attribute;
+            const auto last = first + n.attribute_count;
+
+            // Find the attributes android.content.res.XmlBlock looks up
+            // directly. The indices are 1-based.
+            uint16_t id_index = 0;
+            uint16_t class_index = 0;
+            uint16_t style_index = 0;
+            for (auto it = first; it != last; ++it) {
+                if (it->ns != no_string || (it->name & mapped_flag)) {
+                    continue;
+                }
+                const auto& name = strings_[it->name];
+                const auto index = static_cast<uint16_t>(it - first + 1);
+                if (name == "id") {
+                    id_index = index;
+                }
+                else if (name == "class") {
+                    class_index = index;
+                }
+                else if (name == "style") {
+                    style_index = index;
+                }
+            }
+
+            put_node_header(36 + 20 * n.attribute_count);
+            put32(data_, ref(n.ns));
+            put32(data_, ref(n.name));
+            put16(data_, 20);
+            put16(data_, 20);
+            put16(data_, static_cast<uint16_t>(n.attribute_count));
+            put16(data_, id_index);
+            put16(data_, class_index);
+            put16(data_, style_index);
+            for (auto it = first; it != last; ++it) {
+                const bool is_string = it->data_type == type_string;
+                put32(data_, ref(it->ns));
+                put32(data_, ref(it->name));
+                put32(data_, ref(it->raw_value));
+                put16(data_, 8);
+                data_.push_back(0);
+                data_.push_back(static_cast<char>(it->data_type));
+                put32(data_, is_string ? ref(it->data) : it->data);
+            }
+            break;
+        }
+        case res_xml_cdata_type:
+            put_node_header(28);
+            put32(data_, ref(n.name));
+            put16(data_, 8);
+            data_.push_back(0);
+            data_.push_back(0);
+            put32(data_, 0);
+            break;
+        default:
+            put_node_header(24);
+            put32(data_, ref(n.ns));
+            put32(data_, ref(n.name));
+        }
+    }
+
+    set32(data_, 4, static_cast<uint32_t>(data_.size()));
+}
+
+void axml_encoder::start_namespace(boost::string_ref prefix,
+                                   boost::string_ref uri)
+{
+    close_start_element();
+    const auto uri_index = add_string(uri);
+    namespaces_.push_back({prefix.to_string(), uri_index, uri == android_uri});
+    add_node(res_xml_start_namespace_type, add_string(prefix), uri_index);
+}
+
+void axml_encoder::end_namespace(boost::string_ref prefix,
+                                 boost::string_ref uri)
+{
+    close_start_element();
+    add_node(res_xml_end_namespace_type, add_string(prefix), add_string(uri));
+
+    // Bring the declaration shadowed by this one back into scope.
+    for (auto it = namespaces_.rbegin(); it != namespaces_.rend(); ++it) {
+        if (it->prefix == prefix) {
+            namespaces_.erase(std::next(it).base());
+            break;
+        }
+    }
+}
+
+void axml_encoder::start_element(boost::string_ref name)
+{
+    close_start_element();
+    nodes_.push_back({res_xml_start_element_type, no_string, add_string(name),
+                      static_cast<uint32_t>(attributes_.size()), 0});
+    in_start_element_ = true;
+}
+
+void axml_encoder::attribute(boost::string_ref name, boost::string_ref value)
+{
+    if (!in_start_element_) {
+        throw axml_encoder_error("attribute outside of start tag");
+    }
+
+    attribute_entry a{no_string, 0, no_string, type_string, 0, 0};
+
+    // Resolve the prefix with the innermost declaration. The name is kept
+    // as is if the prefix is not declared.
+    auto local = name;
+    const auto colon = name.find(':');
+    if (colon != boost::string_ref::npos) {
+        const auto prefix = name.substr(0, colon);
+        const auto it = std::find_if(
+                namespaces_.rbegin(), namespaces_.rend(),
+                [&](const auto& ns) { return ns.prefix == prefix; });
+        if (it != namespaces_.rend()) {
+            a.ns = it->uri;
+            local = name.substr(colon + 1);
+            if (it->android) {
+                a.resource_id = android_attr_resource_id(local);
+            }
+        }
+    }
+    a.name = a.resource_id ? add_mapped_name(local, a.resource_id)
+                           : add_string(local);
+
+    // Without resources.arsc, the references by name cannot be resolved to
+    // the IDs, which Android needs.
+    if (value.size() > 1 && (value.front() == '@' || value.front() == '?')) {
+        throw axml_encoder_error("unresolved reference " + value.to_string()
+                                 + " in " + name.to_string());
+    }
+
+    const bool string_format = a.resource_id
+            ? android_attr_is_string(a.resource_id)
+            : is_string_manifest_attribute(name);
+    if (!parse_typed_value(value, string_format, a.data_type, a.data)) {
+        a.raw_value = add_string(value);
+        a.data_type = type_string;
+        a.data = a.raw_value;
+    }
+
+    attributes_.push_back(a);
+    ++nodes_.back().attribute_count;
+}
+
+void axml_encoder::end_element(boost::string_ref name)
+{
+    close_start_element();
+    add_node(res_xml_end_element_type, no_string, add_string(name));
+}
+
+void axml_encoder::cdata(boost::string_ref text)
+{
+    close_start_element();
+    add_node(res_xml_cdata_type, no_string, add_string(text));
+}
+
+uint32_t axml_encoder::add_string(boost::string_ref s)
+{
+    key_.assign(s.data(), s.size());
+    auto it = string_indices_.find(key_);
+    if (it != string_indices_.end()) {
+        return it->second;
+    }
+    const auto index = static_cast<uint32_t>(strings_.size());
+    strings_.push_back(key_);
+    string_indices_.emplace(key_, index);
+    return index;
+}
+
+uint32_t axml_encoder::add_mapped_name(boost::string_ref name, uint32_t id)
+{
+    auto it = mapped_name_indices_.find(id);
+    if (it != mapped_name_indices_.end()) {
+        return it->second | mapped_flag;
+    }
+    const auto index = static_cast<uint32_t>(mapped_names_.size());
+    mapped_names_.emplace_back(id, name.to_string());
+    mapped_name_indices_.emplace(id, index);
+    return index | mapped_flag;
+}
+
+void axml_encoder::add_node(uint16_t type, uint32_t ns, uint32_t name)
+{
+    nodes_.push_back({type, ns, name, 0, 0});
+}
+
+void axml_encoder::close_start_element()
+{
+    if (!in_start_element_) {
+        return;
+    }
+    in_start_element_ = false;
+
+    // Put the attributes with the resource IDs first in the order of the
+    // IDs. Subtracting 1 wraps the attributes without IDs to the end.
+    const auto first = begin(attributes_) + nodes_.back().first_attribute;
+    std::stable_sort(first, end(attributes_),
+                     [](const attribute_entry& a, const attribute_entry& b) {
+                         return a.resource_id - 1 < b.resource_id - 1;
+                     });
+}
+
+void axml_encoder::write_string_pool(const std::vector<uint32_t>& mapped_order)
+{
+    const auto count = mapped_order.size() + strings_.size();
+    const auto chunk_start = data_.size();
+    put_chunk_header(data_, res_string_pool_type, 28, 0);
+    put32(data_, static_cast<uint32_t>(count));
+    put32(data_, 0);
+    put32(data_, utf8_ ? 1 << 8 : 0);
+    put32(data_, static_cast<uint32_t>(28 + 4 * count));
+    put32(data_, 0);
+
+    const auto offsets_start = data_.size();
+    data_.resize(offsets_start + 4 * count);
+    const auto strings_start = data_.size();
+    size_t i = 0;
+    auto write = [&](const std::string& s) {
+        set32(data_, offsets_start + 4 * i++,
+              static_cast<uint32_t>(data_.size() - strings_start));
+        write_string(s);
+    };
+    for (auto k : mapped_order) {
+        write(mapped_names_[k].second);
+    }
+    for (const auto& s : strings_) {
+        write(s);
+    }
+    while (data_.size() % 4 != 0) {
+        data_.push_back(0);
+    }
+
+    set32(data_, chunk_start + 4,
+          static_cast<uint32_t>(data_.size() - chunk_start));
+}
+
+void axml_encoder::write_string(const std::string& s)
+{
+    // Only the non-ASCII strings need converting to UTF-16.
+    const bool ascii = std::all_of(begin(s), end(s),
+                                   [](char c) { return (c & 0x80) == 0; });
+    size_t units = s.size();
+    if (!ascii) {
+        units_ = boost::locale::conv::utf_to_utf<char16_t>(s);
+        units = units_.size();
+    }
+
+    if (utf8_) {
+        // Both the UTF-16 and the UTF-8 lengths precede the string.
+        if (units > 0x7fff || s.size() > 0x7fff) {
+            throw axml_encoder_error("string too long for UTF-8 string pool");
+        }
+        for (auto len : {units, s.size()}) {
+            if (len > 0x7f) {
+                data_.push_back(static_cast<char>(0x80 | (len >> 8)));
+            }
+            data_.push_back(static_cast<char>(len));
+        }
+        data_.insert(end(data_), begin(s), end(s));
+        data_.push_back(0);
+        return;
+    }
+
+    if (units > 0x7fffffff) {
+        throw axml_encoder_error("string too long for string pool");
+    }
+    if (units > 0x7fff) {
+        put16(data_, static_cast<uint16_t>(0x8000 | (units >> 16)));
+    }
+    put16(data_, static_cast<uint16_t>(units));
+
+    const auto pos = data_.size();
+    data_.resize(pos + 2 * units + 2);
+    auto* p = &data_[pos];
+    if (ascii) {
+        for (auto c : s) {
+            *p++ = c;
+            *p++ = 0;
+        }
+    }
+    else {
+        for (auto u : units_) {
+            *p++ = static_cast<char>(u);
+            *p++ = static_cast<char>(u >> 8);
+        }
+    }
+    *p++ = 0;
+    *p = 0;
+}
+
+void jitana::write_axml(const boost::property_tree::ptree& pt,
+                        std::vector<char>& data, bool utf8)
+{
+    axml_encoder encoder(utf8);
+    encoder.start_document();
+    for (const auto& child : pt) {
+        if (child.first != "<xmlcomment>" && child.first != "<xmltext>") {
+            write_element(child.second, child.first, encoder);
+        }
+    }
+    encoder.end_document();
+    data = encoder.data();
+}
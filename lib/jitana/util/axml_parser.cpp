@@ -14,20 +14,63 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
 
 #include <boost/iostreams/device/mapped_file.hpp>
-#include <boost/locale.hpp>
 
+#include "jitana/util/android_attrs.hpp"
 #include "jitana/util/axml_parser.hpp"
+#include "jitana/util/decode_stats.hpp"
+#include "jitana/util/resource_table.hpp"
 #include "jitana/util/stream_reader.hpp"
+#include "jitana/util/utf16.hpp"
 
 using namespace jitana;
 
+namespace {
+    void append_uint(std::string& out, uint32_t x)
+    {
+        char buf[10];
+        char* p = buf + sizeof(buf);
+        do {
+            *--p = static_cast<char>('0' + x % 10);
+            x /= 10;
+        } while (x != 0);
+        out.append(p, buf + sizeof(buf));
+    }
+
+    void append_hex(std::string& out, uint32_t x)
+    {
+        static const char digits[] = "0123456789abcdef";
+        char buf[8];
+        char* p = buf + sizeof(buf);
+        do {
+            *--p = digits[x & 0xf];
+            x >>= 4;
+        } while (x != 0);
+        out.append(p, buf + sizeof(buf));
+    }
+
+    /// Appends the float in the default std::ostream format, which is "%g"
+    /// with the precision of 6.
+    void append_float(std::string& out, float x)
+    {
+        char buf[32];
+        auto n = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(x));
+        out.append(buf, n);
+    }
+}
+
 namespace jitana {
     class axml_parser {
     private:
@@ -130,58 +173,34 @@ namespace jitana {
                 type_last_int = 0x1f
             };
 
-            friend inline std::ostream& operator<<(std::ostream& os,
-                                                   const resource_value& x)
+            /// Appends the value in the same format as the std::ostream
+            /// operator<<() of the numbers.
+            void format(std::string& out) const
             {
-                auto print_complex = [&](bool frac) {
+                static const char* const complex_unit_suffixes[16]
+                        = {"px", "dip", "sp", "pt", "in", "mm"};
+                static const char* const fraction_unit_suffixes[16]
+                        = {"%", "%p"};
+
+                auto format_complex = [&](const char* const* suffixes,
+                                          float scale) {
                     constexpr float mantissa_mult = 1.0f / (1 << 8);
                     constexpr float radix_mults[]
                             = {mantissa_mult * 1.0f,
                                mantissa_mult * 1.0f / (1 << 7),
                                mantissa_mult * 1.0f / (1 << 15),
                                mantissa_mult * 1.0f / (1 << 23)};
-                    float value = static_cast<int32_t>(x.data & 0xffffff00)
-                            * radix_mults[(x.data >> 4) & 0x3];
-
-                    if (frac) {
-                        os << value * 100;
-                        switch (x.data & 0xf) {
-                        case complex_unit_fraction:
-                            os << "%";
-                            break;
-                        case complex_unit_fraction_parent:
-                            os << "%p";
-                            break;
-                        }
-                    }
-                    else {
-                        os << value;
-                        switch (x.data & 0xf) {
-                        case complex_unit_px:
-                            os << "px";
-                            break;
-                        case complex_unit_dip:
-                            os << "dip";
-                            break;
-                        case complex_unit_sp:
-                            os << "sp";
-                            break;
-                        case complex_unit_pt:
-                            os << "pt";
-                            break;
-                        case complex_unit_in:
-                            os << "in";
-                            break;
-                        case complex_unit_mm:
-                            os << "mm";
-                            break;
-                        }
+                    float value = static_cast<int32_t>(data & 0xffffff00)
+                            * radix_mults[(data >> 4) & 0x3];
+                    append_float(out, value * scale);
+                    if (const auto* suffix = suffixes[data & 0xf]) {
+                        out += suffix;
                     }
                 };
 
-                switch (x.data_type) {
+                switch (data_type) {
                 case type_null:
-                    os << "null";
+                    out += "null";
                     break;
                 // case type_reference:
                 //     break;
@@ -191,30 +210,30 @@ namespace jitana {
                 //     break;
                 case type_float:
                     float f;
-                    std::memcpy(&f, &x.data, sizeof(f));
-                    os << f;
+                    std::memcpy(&f, &data, sizeof(f));
+                    append_float(out, f);
                     break;
                 case type_dimension:
-                    print_complex(false);
+                    format_complex(complex_unit_suffixes, 1);
                     break;
                 case type_fraction:
-                    print_complex(true);
+                    format_complex(fraction_unit_suffixes, 100);
                     break;
                 // case type_dynamic_reference:
                 //     break;
                 // case type_first_int:
                 //     break;
                 case type_int_dec:
-                    os << std::dec << x.data;
+                    append_uint(out, data);
                     break;
                 case type_int_hex:
-                    os << "0x" << std::hex << x.data;
+                    out += "0x";
+                    append_hex(out, data);
                     break;
                 case type_int_boolean:
-                    os << (x.data ? "true" : "false");
+                    out += data ? "true" : "false";
                     break;
                 // case type_first_color_int:
-                //     os << x.data;
                 //     break;
                 // case type_int_color_argb8:
                 //     break;
@@ -229,78 +248,153 @@ namespace jitana {
                 // case type_last_int:
                 //     break;
                 default:
-                    os << "type" << (int)x.data_type << "/" << x.data;
+                    out += "type";
+                    append_uint(out, data_type);
+                    out += '/';
+                    append_uint(out, data);
                 }
-
-                return os;
             }
         };
 
     public:
-        axml_parser(stream_reader& reader, boost::property_tree::ptree& pt)
-                : reader_(reader), pt_(pt)
+        explicit axml_parser(axml_handler& handler) : handler_(&handler)
+        {
+        }
+
+        /// Changes the handler for the next document.
+        void set_handler(axml_handler& handler)
+        {
+            handler_ = &handler;
+        }
+
+        /// Sets the resource table to resolve the references. Null disables
+        /// it.
+        void set_resource_table(const resource_table* table)
+        {
+            table_ = table;
+        }
+
+        /// Sets the statistics to collect into. Null disables it.
+        void set_stats(decode_stats* stats)
         {
+            stats_ = stats;
         }
 
-        void parse()
+        /// Parses the whole binary XML in the memory range.
+        void parse(const void* first, const void* last)
         {
-            xml_stack_.clear();
-            xml_stack_.emplace_back(&pt_);
+            const auto doc_size = parse_document_header(first, last);
+
+            // Apply pull parsing.
+            stream_reader reader(first, last);
+            reader.move_head(sizeof(res_chunk_header));
+            while (reader.head() < doc_size) {
+                const auto& header = reader.peek<res_chunk_header>();
+                if (header.size < sizeof(res_chunk_header)) {
+                    throw axml_parser_error("invalid chunk size");
+                }
+
+                const auto* chunk = static_cast<const uint8_t*>(first)
+                        + reader.head();
+                const auto* chunk_last = chunk
+                        + std::min<size_t>(header.size,
+                                           reader.size() - reader.head());
+                parse_chunk(chunk, chunk_last, false);
+
+                reader.move_head_forward(header.size);
+            }
+
+            end_document();
+        }
+
+        /// Checks the header of the binary XML and starts the document.
+        /// Returns the size of the document.
+        size_t parse_document_header(const void* first, const void* last)
+        {
+            namespaces_.clear();
+            namespace_by_uri_.clear();
+            namespace_frames_.assign(1, 0);
+            qualified_names_.clear();
 
             // Make sure that the file is large enough.
-            if (reader_.size() < sizeof(res_chunk_header)) {
+            stream_reader reader(first, last);
+            if (reader.size() < sizeof(res_chunk_header)) {
                 throw axml_parser_not_an_axml_file("not a binary XML file");
             }
 
-            const auto& header = reader_.get<res_chunk_header>();
+            const auto& header = reader.get<res_chunk_header>();
 
             // Make sure it's the right file type.
             if (header.type != res_xml_type) {
                 throw axml_parser_not_an_axml_file("not a binary XML file");
             }
 
-            // Apply pull parsing.
-            while (reader_.head() < static_cast<size_t>(header.size)) {
-                auto saved_reader = reader_;
+            handler_->start_document();
 
-                const auto& header = reader_.peek<res_chunk_header>();
-                switch (header.type) {
-                case res_string_pool_type:
-                    parse_string_pool();
-                    break;
-                case res_xml_resource_map_type:
-                    parse_resource_map();
-                    break;
-                case res_xml_start_namespace_type:
-                    parse_start_namespace();
-                    break;
-                case res_xml_end_namespace_type:
-                    parse_end_namespace();
-                    break;
-                case res_xml_start_element_type:
-                    parse_xml_start_element();
-                    break;
-                case res_xml_end_element_type:
-                    parse_xml_end_element();
-                    break;
-                case res_xml_cdata_type:
-                    parse_xml_cdata();
-                    break;
-                default:
-                    std::stringstream ss;
-                    ss << "unknown chunk type 0x" << std::hex << header.type;
-                    throw axml_parser_error(ss.str());
-                }
+            return header.size;
+        }
+
+        /// Parses a chunk. If the chunk is transient, the string pool is
+        /// copied since the strings are referenced by the following chunks.
+        void parse_chunk(const uint8_t* first, const uint8_t* last,
+                         bool transient)
+        {
+            reader_.set_memory_range(first, last);
 
-                reader_ = saved_reader;
-                reader_.move_head_forward(header.size);
+            const auto& header = reader_.peek<res_chunk_header>();
+            if (stats_) {
+                ++stats_->chunks[header.type];
+            }
+            switch (header.type) {
+            case res_string_pool_type:
+                if (transient) {
+                    owned_string_pool_.assign(first, last);
+                    reader_.set_memory_range(
+                            owned_string_pool_.data(),
+                            owned_string_pool_.data()
+                                    + owned_string_pool_.size());
+                }
+                parse_string_pool();
+                break;
+            case res_xml_resource_map_type:
+                parse_resource_map();
+                break;
+            case res_xml_start_namespace_type:
+                parse_start_namespace();
+                break;
+            case res_xml_end_namespace_type:
+                parse_end_namespace();
+                break;
+            case res_xml_start_element_type:
+                parse_xml_start_element();
+                break;
+            case res_xml_end_element_type:
+                parse_xml_end_element();
+                break;
+            case res_xml_cdata_type:
+                parse_xml_cdata();
+                break;
+            default:
+                std::stringstream ss;
+                ss << "unknown chunk type 0x" << std::hex << header.type;
+                throw axml_parser_error(ss.str());
             }
         }
 
+        /// Finishes the document.
+        void end_document()
+        {
+            handler_->end_document();
+        }
+
     private:
         void parse_string_pool()
         {
-            /*const auto& header =*/reader_.get<res_chunk_header>();
+            phase_timer timer(stats_, decode_phase::string_pool);
+
+            const auto* chunk = static_cast<const uint8_t*>(reader_.begin())
+                    + reader_.head();
+            const auto& header = reader_.get<res_chunk_header>();
 
             auto string_count = reader_.get<uint32_t>();
             auto style_count = reader_.get<uint32_t>();
@@ -313,47 +407,120 @@ namespace jitana {
             if (style_count != 0) {
                 throw axml_parser_error("styles are not supported");
             }
-
-            // Get the string offsets.
-            std::vector<uint32_t> string_offsets(string_count);
-            for (auto& off : string_offsets) {
-                off = reader_.get<uint32_t>();
+            if (stats_) {
+                stats_->strings += string_count;
             }
 
-            // Fill the string table.
+            // Remember where the string offsets and the strings are. The
+            // strings are decoded when they are first referenced.
+            qualified_names_.clear();
+            const auto* end = static_cast<const uint8_t*>(reader_.end());
+            const size_t pool_size = std::min<size_t>(header.size, end - chunk);
+            string_pool_.set_memory_range(chunk, chunk + pool_size);
+            string_pool_utf8_ = utf8_flag;
+            string_offsets_start_ = static_cast<uint32_t>(
+                    static_cast<const uint8_t*>(reader_.begin())
+                    + reader_.head() - chunk);
+            strings_start_ = strings_start;
+
             strings_.clear();
-            strings_.reserve(string_count);
-            for (auto off : string_offsets) {
-                reader_.move_head(strings_start + 8 + off);
+            strings_.resize(string_count);
+            string_decoded_.assign(string_count, false);
+
+            // UTF-8 strings are referenced in place. UTF-16 strings are
+            // converted into the arena, which never exceeds the reserved
+            // capacity unless the offsets overlap, so the views stay valid.
+            string_arena_size_ = 0;
+            string_arena_capacity_ = 0;
+            string_arena_overflow_.clear();
+            if (!utf8_flag && strings_start < pool_size) {
+                const auto units = (pool_size - strings_start) / 2;
+                string_arena_capacity_ = utf16_to_utf8_max_size(units);
+                if (string_arena_capacity_ > string_arena_allocated_) {
+                    string_arena_.reset(new char[string_arena_capacity_]);
+                    string_arena_allocated_ = string_arena_capacity_;
+                }
+            }
+        }
+
+        boost::string_ref get_string(uint32_t index)
+        {
+            if (index >= strings_.size()) {
+                throw axml_parser_error("invalid string index");
+            }
 
-                strings_.emplace_back();
-                auto& str = strings_.back();
+            if (!string_decoded_[index]) {
+                strings_[index] = stats_ ? decode_string_timed(index)
+                                         : decode_string(index);
+                string_decoded_[index] = true;
+            }
 
-                if (utf8_flag) {
-                    reader_.get<uint8_t>();
+            return strings_[index];
+        }
 
-                    // Compute the string length.
-                    size_t len = reader_.get<uint8_t>();
-                    if (len & 0x80) {
-                        /*len |= ((len & 0x7f) << 8) |*/ reader_.get<uint8_t>();
-                    }
+        /// Decodes the string attributing the time to the string pool. It
+        /// is kept apart so that decoding without the statistics is not
+        /// slowed down.
+        boost::string_ref decode_string_timed(uint32_t index)
+        {
+            phase_timer timer(stats_, decode_phase::string_pool);
+            return decode_string(index);
+        }
 
-                    // Fill characters.
-                    if (len != 0) {
-                        str = reader_.get_c_str();
-                    }
+        boost::string_ref decode_string(uint32_t index)
+        {
+            string_pool_.move_head(string_offsets_start_ + 4 * index);
+            auto off = string_pool_.get<uint32_t>();
+            string_pool_.move_head(strings_start_ + off);
+
+            if (string_pool_utf8_) {
+                // Skip the length in UTF-16.
+                if (string_pool_.get<uint8_t>() & 0x80) {
+                    string_pool_.get<uint8_t>();
                 }
-                else {
-                    // Compute the string length.
-                    size_t len = reader_.get<uint16_t>();
-                    if (len & 0x8000) {
-                        len |= ((len & 0x7fff) << 16) | reader_.get<uint16_t>();
-                    }
 
-                    // Convert to UTF-8.
-                    auto* ptr = &reader_.peek<uint16_t>();
-                    str = boost::locale::conv::utf_to_utf<char>(ptr, ptr + len);
+                // Compute the string length.
+                size_t len = string_pool_.get<uint8_t>();
+                if (len & 0x80) {
+                    /*len |= ((len & 0x7f) << 8) |*/
+                    string_pool_.get<uint8_t>();
                 }
+
+                // Refer to the characters in the buffer.
+                if (len == 0) {
+                    return boost::string_ref();
+                }
+                const auto* first = string_pool_.get_c_str();
+                const auto* last
+                        = static_cast<const char*>(string_pool_.begin())
+                        + string_pool_.head() - 1;
+                return boost::string_ref(first, last - first);
+            }
+            else {
+                // Compute the string length.
+                size_t len = string_pool_.get<uint16_t>();
+                if (len & 0x8000) {
+                    len = ((len & 0x7fff) << 16)
+                            | string_pool_.get<uint16_t>();
+                }
+
+                if (len > (string_pool_.size() - string_pool_.head()) / 2) {
+                    throw axml_parser_error("invalid string length");
+                }
+
+                // Convert to UTF-8.
+                auto* ptr = &string_pool_.peek<uint16_t>();
+                const auto max_size = utf16_to_utf8_max_size(len);
+                if (string_arena_size_ + max_size > string_arena_capacity_) {
+                    std::string str(max_size, '\0');
+                    str.resize(utf16_to_utf8(ptr, ptr + len, &str[0]));
+                    string_arena_overflow_.push_back(std::move(str));
+                    return string_arena_overflow_.back();
+                }
+                auto* out = string_arena_.get() + string_arena_size_;
+                const auto size = utf16_to_utf8(ptr, ptr + len, out);
+                string_arena_size_ += size;
+                return boost::string_ref(out, size);
             }
         }
 
@@ -362,6 +529,7 @@ namespace jitana {
             const auto& header = reader_.get<res_chunk_header>();
 
             attr_names_res_ids_.clear();
+            qualified_names_.clear();
             for (size_t i = 0; i < (header.size - sizeof(header)) / 4; ++i) {
                 auto id = reader_.get<uint32_t>();
                 attr_names_res_ids_.push_back(id);
@@ -377,7 +545,11 @@ namespace jitana {
             auto prefix = reader_.get<uint32_t>();
             auto uri = reader_.get<uint32_t>();
 
-            xml_stack_.back().namespaces.emplace_back(uri, prefix);
+            // Check the indices before namespace_by_uri_ is sized by them.
+            const auto prefix_str = get_string(prefix);
+            const auto uri_str = get_string(uri);
+            push_namespace(prefix, uri);
+            handler_->start_namespace(prefix_str, uri_str);
         }
 
         void parse_end_namespace()
@@ -386,16 +558,19 @@ namespace jitana {
 
             /*auto line_num =*/reader_.get<uint32_t>();
             /*auto comment =*/reader_.get<uint32_t>();
-            /*auto prefix =*/reader_.get<uint32_t>();
-            /*auto uri =*/reader_.get<uint32_t>();
+            auto prefix = reader_.get<uint32_t>();
+            auto uri = reader_.get<uint32_t>();
 
-            xml_stack_.back().namespaces.pop_back();
+            const auto prefix_str = get_string(prefix);
+            const auto uri_str = get_string(uri);
+            if (namespaces_.size() > namespace_frames_.back()) {
+                pop_namespace();
+            }
+            handler_->end_namespace(prefix_str, uri_str);
         }
 
         void parse_xml_start_element()
         {
-            using path_type = boost::property_tree::ptree::path_type;
-
             /*const auto& header =*/reader_.get<res_chunk_header>();
 
             /*auto line_num =*/reader_.get<uint32_t>();
@@ -408,52 +583,57 @@ namespace jitana {
             /*auto class_index =*/reader_.get<uint16_t>();
             /*auto style_index =*/reader_.get<uint16_t>();
 
-            // Create ptree for the new element.
-            auto& elem_pt = xml_stack_.back().pt->add(
-                    path_type(strings_[name], '`'), "");
-            for (const auto& ns : xml_stack_.back().namespaces) {
-                elem_pt.add(path_type("<xmlattr>`xmlns:" + strings_[ns.second],
-                                      '`'),
-                            strings_[ns.first]);
+            handler_->start_element(get_string(name));
+            namespace_frames_.push_back(namespaces_.size());
+            if (stats_) {
+                ++stats_->elements;
+                stats_->attributes += attribute_count;
+                stats_->max_depth = std::max<uint64_t>(
+                        stats_->max_depth, namespace_frames_.size() - 1);
             }
-            xml_stack_.emplace_back(&elem_pt);
 
-            // Create ptree for the attributes.
+            // Report the attributes.
             for (int i = 0; i < attribute_count; ++i) {
                 auto attr_ns = reader_.get<uint32_t>();
                 auto attr_name = reader_.get<uint32_t>();
                 auto attr_raw_val = reader_.get<uint32_t>();
                 auto value = reader_.get<resource_value>();
 
-                std::string name = "<xmlattr>`";
-                if (attr_ns != 0xffffffff) {
-                    auto prefix = lookup_prefix(attr_ns);
-                    if (prefix != 0xffffffff) {
-                        // Add namespace prefix.
-                        name += strings_[prefix];
-                        name += ":";
-                    }
-                }
-                if (strings_[attr_name].empty()) {
-                    if (attr_name >= attr_names_res_ids_.size()) {
-                        throw axml_parser_error("undefined attr name");
-                    }
-                    name += get_resource_string(attr_names_res_ids_[attr_name]);
-                }
-                else {
-                    name += strings_[attr_name];
-                }
+                auto prefix = (attr_ns != 0xffffffff) ? lookup_prefix(attr_ns)
+                                                      : 0xffffffff;
+                const auto& name = qualified_name(prefix, attr_name);
 
-                std::stringstream ss;
                 if (attr_raw_val != 0xffffffff) {
-                    ss << strings_[attr_raw_val];
+                    handler_->attribute(name, get_string(attr_raw_val));
                 }
                 else {
-                    // TODO: print in human readable format.
-                    ss << value;
+                    value_buffer_.clear();
+                    if (!format_reference(value)) {
+                        value.format(value_buffer_);
+                    }
+                    handler_->attribute(name, value_buffer_);
                 }
+            }
+        }
+
+        /// Prints the reference by name into value_buffer_ if the resource
+        /// table knows it.
+        bool format_reference(const resource_value& value)
+        {
+            if (table_ == nullptr || value.data == 0) {
+                return false;
+            }
 
-                elem_pt.add(path_type(name, '`'), ss.str());
+            switch (value.data_type) {
+            case resource_value::type_reference:
+            case resource_value::type_dynamic_reference:
+                return table_->format_reference(value.data, '@',
+                                                value_buffer_);
+            case resource_value::type_attribute:
+                return table_->format_reference(value.data, '?',
+                                                value_buffer_);
+            default:
+                return false;
             }
         }
 
@@ -464,9 +644,16 @@ namespace jitana {
             /*auto line_num =*/reader_.get<uint32_t>();
             /*auto comment =*/reader_.get<uint32_t>();
             /*auto ns =*/reader_.get<uint32_t>();
-            /*auto name =*/reader_.get<uint32_t>();
+            auto name = reader_.get<uint32_t>();
 
-            xml_stack_.pop_back();
+            // Drop the namespaces left in the element.
+            if (namespace_frames_.size() > 1) {
+                while (namespaces_.size() > namespace_frames_.back()) {
+                    pop_namespace();
+                }
+                namespace_frames_.pop_back();
+            }
+            handler_->end_element(get_string(name));
         }
 
         void parse_xml_cdata()
@@ -479,1404 +666,428 @@ namespace jitana {
             reader_.get<uint32_t>();
             reader_.get<uint32_t>();
 
-            xml_stack_.back().pt->add("<xmltext>", strings_[text]);
+            handler_->cdata(get_string(text));
+        }
+
+        void push_namespace(uint32_t prefix, uint32_t uri)
+        {
+            if (uri >= namespace_by_uri_.size()) {
+                namespace_by_uri_.resize(uri + 1, no_namespace);
+            }
+
+            // Shadow the namespace with the same URI until this one is
+            // popped.
+            namespaces_.push_back({prefix, uri, namespace_by_uri_[uri]});
+            namespace_by_uri_[uri] = namespaces_.size() - 1;
+        }
+
+        void pop_namespace()
+        {
+            const auto& ns = namespaces_.back();
+            namespace_by_uri_[ns.uri] = ns.shadowed;
+            namespaces_.pop_back();
         }
 
         uint32_t lookup_prefix(uint32_t uri)
         {
-            auto stack_it = xml_stack_.rbegin();
-            ++stack_it;
-            for (; stack_it != xml_stack_.rend(); ++stack_it) {
-                const auto& v = stack_it->namespaces;
-                auto it = std::find_if(
-                        v.rbegin(), v.rend(),
-                        [&](const std::pair<uint32_t, uint32_t>& x) {
-                            return x.first == uri;
-                        });
-                if (it != v.rend()) {
-                    return it->second;
+            if (uri < namespace_by_uri_.size()) {
+                auto i = namespace_by_uri_[uri];
+                if (i != no_namespace) {
+                    return namespaces_[i].prefix;
                 }
             }
 
             return 0xffffffff;
         }
 
-        const char* get_resource_string(uint16_t id)
+        /// Returns the attribute name with the namespace prefix. The names
+        /// are built once per pair of the prefix and the name.
+        const std::string& qualified_name(uint32_t prefix, uint32_t attr_name)
+        {
+            auto key = (static_cast<uint64_t>(prefix) << 32) | attr_name;
+            auto it = qualified_names_.find(key);
+            if (it != qualified_names_.end()) {
+                return it->second;
+            }
+
+            std::string name;
+            if (prefix != 0xffffffff) {
+                // Add namespace prefix.
+                auto prefix_str = get_string(prefix);
+                name.append(prefix_str.data(), prefix_str.size());
+                name += ":";
+            }
+            auto attr_name_str = get_string(attr_name);
+            if (attr_name_str.empty()) {
+                if (attr_name >= attr_names_res_ids_.size()) {
+                    throw axml_parser_error("undefined attr name");
+                }
+                append_attr_name(name, attr_names_res_ids_[attr_name]);
+            }
+            else {
+                name.append(attr_name_str.data(), attr_name_str.size());
+            }
+
+            return qualified_names_.emplace(key, std::move(name)).first->second;
+        }
+
+        void append_attr_name(std::string& name, uint32_t id)
         {
-            static const char* attr_names[]
-                    = {"theme",
-                       "label",
-                       "icon",
-                       "name",
-                       "manageSpaceActivity",
-                       "allowClearUserData",
-                       "permission",
-                       "readPermission",
-                       "writePermission",
-                       "protectionLevel",
-                       "permissionGroup",
-                       "sharedUserId",
-                       "hasCode",
-                       "persistent",
-                       "enabled",
-                       "debuggable",
-                       "exported",
-                       "process",
-                       "taskAffinity",
-                       "multiprocess",
-                       "finishOnTaskLaunch",
-                       "clearTaskOnLaunch",
-                       "stateNotNeeded",
-                       "excludeFromRecents",
-                       "authorities",
-                       "syncable",
-                       "initOrder",
-                       "grantUriPermissions",
-                       "priority",
-                       "launchMode",
-                       "screenOrientation",
-                       "configChanges",
-                       "description",
-                       "targetPackage",
-                       "handleProfiling",
-                       "functionalTest",
-                       "value",
-                       "resource",
-                       "mimeType",
-                       "scheme",
-                       "host",
-                       "port",
-                       "path",
-                       "pathPrefix",
-                       "pathPattern",
-                       "action",
-                       "data",
-                       "targetClass",
-                       "colorForeground",
-                       "colorBackground",
-                       "backgroundDimAmount",
-                       "disabledAlpha",
-                       "textAppearance",
-                       "textAppearanceInverse",
-                       "textColorPrimary",
-                       "textColorPrimaryDisableOnly",
-                       "textColorSecondary",
-                       "textColorPrimaryInverse",
-                       "textColorSecondaryInverse",
-                       "textColorPrimaryNoDisable",
-                       "textColorSecondaryNoDisable",
-                       "textColorPrimaryInverseNoDisable",
-                       "textColorSecondaryInverseNoDisable",
-                       "textColorHintInverse",
-                       "textAppearanceLarge",
-                       "textAppearanceMedium",
-                       "textAppearanceSmall",
-                       "textAppearanceLargeInverse",
-                       "textAppearanceMediumInverse",
-                       "textAppearanceSmallInverse",
-                       "textCheckMark",
-                       "textCheckMarkInverse",
-                       "buttonStyle",
-                       "buttonStyleSmall",
-                       "buttonStyleInset",
-                       "buttonStyleToggle",
-                       "galleryItemBackground",
-                       "listPreferredItemHeight",
-                       "expandableListPreferredItemPaddingLeft",
-                       "expandableListPreferredChildPaddingLeft",
-                       "expandableListPreferredItemIndicatorLeft",
-                       "expandableListPreferredItemIndicatorRight",
-                       "expandableListPreferredChildIndicatorLeft",
-                       "expandableListPreferredChildIndicatorRight",
-                       "windowBackground",
-                       "windowFrame",
-                       "windowNoTitle",
-                       "windowIsFloating",
-                       "windowIsTranslucent",
-                       "windowContentOverlay",
-                       "windowTitleSize",
-                       "windowTitleStyle",
-                       "windowTitleBackgroundStyle",
-                       "alertDialogStyle",
-                       "panelBackground",
-                       "panelFullBackground",
-                       "panelColorForeground",
-                       "panelColorBackground",
-                       "panelTextAppearance",
-                       "scrollbarSize",
-                       "scrollbarThumbHorizontal",
-                       "scrollbarThumbVertical",
-                       "scrollbarTrackHorizontal",
-                       "scrollbarTrackVertical",
-                       "scrollbarAlwaysDrawHorizontalTrack",
-                       "scrollbarAlwaysDrawVerticalTrack",
-                       "absListViewStyle",
-                       "autoCompleteTextViewStyle",
-                       "checkboxStyle",
-                       "dropDownListViewStyle",
-                       "editTextStyle",
-                       "expandableListViewStyle",
-                       "galleryStyle",
-                       "gridViewStyle",
-                       "imageButtonStyle",
-                       "imageWellStyle",
-                       "listViewStyle",
-                       "listViewWhiteStyle",
-                       "popupWindowStyle",
-                       "progressBarStyle",
-                       "progressBarStyleHorizontal",
-                       "progressBarStyleSmall",
-                       "progressBarStyleLarge",
-                       "seekBarStyle",
-                       "ratingBarStyle",
-                       "ratingBarStyleSmall",
-                       "radioButtonStyle",
-                       "scrollbarStyle",
-                       "scrollViewStyle",
-                       "spinnerStyle",
-                       "starStyle",
-                       "tabWidgetStyle",
-                       "textViewStyle",
-                       "webViewStyle",
-                       "dropDownItemStyle",
-                       "spinnerDropDownItemStyle",
-                       "dropDownHintAppearance",
-                       "spinnerItemStyle",
-                       "mapViewStyle",
-                       "preferenceScreenStyle",
-                       "preferenceCategoryStyle",
-                       "preferenceInformationStyle",
-                       "preferenceStyle",
-                       "checkBoxPreferenceStyle",
-                       "yesNoPreferenceStyle",
-                       "dialogPreferenceStyle",
-                       "editTextPreferenceStyle",
-                       "ringtonePreferenceStyle",
-                       "preferenceLayoutChild",
-                       "textSize",
-                       "typeface",
-                       "textStyle",
-                       "textColor",
-                       "textColorHighlight",
-                       "textColorHint",
-                       "textColorLink",
-                       "state_focused",
-                       "state_window_focused",
-                       "state_enabled",
-                       "state_checkable",
-                       "state_checked",
-                       "state_selected",
-                       "state_active",
-                       "state_single",
-                       "state_first",
-                       "state_middle",
-                       "state_last",
-                       "state_pressed",
-                       "state_expanded",
-                       "state_empty",
-                       "state_above_anchor",
-                       "ellipsize",
-                       "x",
-                       "y",
-                       "windowAnimationStyle",
-                       "gravity",
-                       "autoLink",
-                       "linksClickable",
-                       "entries",
-                       "layout_gravity",
-                       "windowEnterAnimation",
-                       "windowExitAnimation",
-                       "windowShowAnimation",
-                       "windowHideAnimation",
-                       "activityOpenEnterAnimation",
-                       "activityOpenExitAnimation",
-                       "activityCloseEnterAnimation",
-                       "activityCloseExitAnimation",
-                       "taskOpenEnterAnimation",
-                       "taskOpenExitAnimation",
-                       "taskCloseEnterAnimation",
-                       "taskCloseExitAnimation",
-                       "taskToFrontEnterAnimation",
-                       "taskToFrontExitAnimation",
-                       "taskToBackEnterAnimation",
-                       "taskToBackExitAnimation",
-                       "orientation",
-                       "keycode",
-                       "fullDark",
-                       "topDark",
-                       "centerDark",
-                       "bottomDark",
-                       "fullBright",
-                       "topBright",
-                       "centerBright",
-                       "bottomBright",
-                       "bottomMedium",
-                       "centerMedium",
-                       "id",
-                       "tag",
-                       "scrollX",
-                       "scrollY",
-                       "background",
-                       "padding",
-                       "paddingLeft",
-                       "paddingTop",
-                       "paddingRight",
-                       "paddingBottom",
-                       "focusable",
-                       "focusableInTouchMode",
-                       "visibility",
-                       "fitsSystemWindows",
-                       "scrollbars",
-                       "fadingEdge",
-                       "fadingEdgeLength",
-                       "nextFocusLeft",
-                       "nextFocusRight",
-                       "nextFocusUp",
-                       "nextFocusDown",
-                       "clickable",
-                       "longClickable",
-                       "saveEnabled",
-                       "drawingCacheQuality",
-                       "duplicateParentState",
-                       "clipChildren",
-                       "clipToPadding",
-                       "layoutAnimation",
-                       "animationCache",
-                       "persistentDrawingCache",
-                       "alwaysDrawnWithCache",
-                       "addStatesFromChildren",
-                       "descendantFocusability",
-                       "layout",
-                       "inflatedId",
-                       "layout_width",
-                       "layout_height",
-                       "layout_margin",
-                       "layout_marginLeft",
-                       "layout_marginTop",
-                       "layout_marginRight",
-                       "layout_marginBottom",
-                       "listSelector",
-                       "drawSelectorOnTop",
-                       "stackFromBottom",
-                       "scrollingCache",
-                       "textFilterEnabled",
-                       "transcriptMode",
-                       "cacheColorHint",
-                       "dial",
-                       "hand_hour",
-                       "hand_minute",
-                       "format",
-                       "checked",
-                       "button",
-                       "checkMark",
-                       "foreground",
-                       "measureAllChildren",
-                       "groupIndicator",
-                       "childIndicator",
-                       "indicatorLeft",
-                       "indicatorRight",
-                       "childIndicatorLeft",
-                       "childIndicatorRight",
-                       "childDivider",
-                       "animationDuration",
-                       "spacing",
-                       "horizontalSpacing",
-                       "verticalSpacing",
-                       "stretchMode",
-                       "columnWidth",
-                       "numColumns",
-                       "src",
-                       "antialias",
-                       "filter",
-                       "dither",
-                       "scaleType",
-                       "adjustViewBounds",
-                       "maxWidth",
-                       "maxHeight",
-                       "tint",
-                       "baselineAlignBottom",
-                       "cropToPadding",
-                       "textOn",
-                       "textOff",
-                       "baselineAligned",
-                       "baselineAlignedChildIndex",
-                       "weightSum",
-                       "divider",
-                       "dividerHeight",
-                       "choiceMode",
-                       "itemTextAppearance",
-                       "horizontalDivider",
-                       "verticalDivider",
-                       "headerBackground",
-                       "itemBackground",
-                       "itemIconDisabledAlpha",
-                       "rowHeight",
-                       "maxRows",
-                       "maxItemsPerRow",
-                       "moreIcon",
-                       "max",
-                       "progress",
-                       "secondaryProgress",
-                       "indeterminate",
-                       "indeterminateOnly",
-                       "indeterminateDrawable",
-                       "progressDrawable",
-                       "indeterminateDuration",
-                       "indeterminateBehavior",
-                       "minWidth",
-                       "minHeight",
-                       "interpolator",
-                       "thumb",
-                       "thumbOffset",
-                       "numStars",
-                       "rating",
-                       "stepSize",
-                       "isIndicator",
-                       "checkedButton",
-                       "stretchColumns",
-                       "shrinkColumns",
-                       "collapseColumns",
-                       "layout_column",
-                       "layout_span",
-                       "bufferType",
-                       "text",
-                       "hint",
-                       "textScaleX",
-                       "cursorVisible",
-                       "maxLines",
-                       "lines",
-                       "height",
-                       "minLines",
-                       "maxEms",
-                       "ems",
-                       "width",
-                       "minEms",
-                       "scrollHorizontally",
-                       "password",
-                       "singleLine",
-                       "selectAllOnFocus",
-                       "includeFontPadding",
-                       "maxLength",
-                       "shadowColor",
-                       "shadowDx",
-                       "shadowDy",
-                       "shadowRadius",
-                       "numeric",
-                       "digits",
-                       "phoneNumber",
-                       "inputMethod",
-                       "capitalize",
-                       "autoText",
-                       "editable",
-                       "freezesText",
-                       "drawableTop",
-                       "drawableBottom",
-                       "drawableLeft",
-                       "drawableRight",
-                       "drawablePadding",
-                       "completionHint",
-                       "completionHintView",
-                       "completionThreshold",
-                       "dropDownSelector",
-                       "popupBackground",
-                       "inAnimation",
-                       "outAnimation",
-                       "flipInterval",
-                       "fillViewport",
-                       "prompt",
-                       "startYear",
-                       "endYear",
-                       "mode",
-                       "layout_x",
-                       "layout_y",
-                       "layout_weight",
-                       "layout_toLeftOf",
-                       "layout_toRightOf",
-                       "layout_above",
-                       "layout_below",
-                       "layout_alignBaseline",
-                       "layout_alignLeft",
-                       "layout_alignTop",
-                       "layout_alignRight",
-                       "layout_alignBottom",
-                       "layout_alignParentLeft",
-                       "layout_alignParentTop",
-                       "layout_alignParentRight",
-                       "layout_alignParentBottom",
-                       "layout_centerInParent",
-                       "layout_centerHorizontal",
-                       "layout_centerVertical",
-                       "layout_alignWithParentIfMissing",
-                       "layout_scale",
-                       "visible",
-                       "variablePadding",
-                       "constantSize",
-                       "oneshot",
-                       "duration",
-                       "drawable",
-                       "shape",
-                       "innerRadiusRatio",
-                       "thicknessRatio",
-                       "startColor",
-                       "endColor",
-                       "useLevel",
-                       "angle",
-                       "type",
-                       "centerX",
-                       "centerY",
-                       "gradientRadius",
-                       "color",
-                       "dashWidth",
-                       "dashGap",
-                       "radius",
-                       "topLeftRadius",
-                       "topRightRadius",
-                       "bottomLeftRadius",
-                       "bottomRightRadius",
-                       "left",
-                       "top",
-                       "right",
-                       "bottom",
-                       "minLevel",
-                       "maxLevel",
-                       "fromDegrees",
-                       "toDegrees",
-                       "pivotX",
-                       "pivotY",
-                       "insetLeft",
-                       "insetRight",
-                       "insetTop",
-                       "insetBottom",
-                       "shareInterpolator",
-                       "fillBefore",
-                       "fillAfter",
-                       "startOffset",
-                       "repeatCount",
-                       "repeatMode",
-                       "zAdjustment",
-                       "fromXScale",
-                       "toXScale",
-                       "fromYScale",
-                       "toYScale",
-                       "fromXDelta",
-                       "toXDelta",
-                       "fromYDelta",
-                       "toYDelta",
-                       "fromAlpha",
-                       "toAlpha",
-                       "delay",
-                       "animation",
-                       "animationOrder",
-                       "columnDelay",
-                       "rowDelay",
-                       "direction",
-                       "directionPriority",
-                       "factor",
-                       "cycles",
-                       "searchMode",
-                       "searchSuggestAuthority",
-                       "searchSuggestPath",
-                       "searchSuggestSelection",
-                       "searchSuggestIntentAction",
-                       "searchSuggestIntentData",
-                       "queryActionMsg",
-                       "suggestActionMsg",
-                       "suggestActionMsgColumn",
-                       "menuCategory",
-                       "orderInCategory",
-                       "checkableBehavior",
-                       "title",
-                       "titleCondensed",
-                       "alphabeticShortcut",
-                       "numericShortcut",
-                       "checkable",
-                       "selectable",
-                       "orderingFromXml",
-                       "key",
-                       "summary",
-                       "order",
-                       "widgetLayout",
-                       "dependency",
-                       "defaultValue",
-                       "shouldDisableView",
-                       "summaryOn",
-                       "summaryOff",
-                       "disableDependentsState",
-                       "dialogTitle",
-                       "dialogMessage",
-                       "dialogIcon",
-                       "positiveButtonText",
-                       "negativeButtonText",
-                       "dialogLayout",
-                       "entryValues",
-                       "ringtoneType",
-                       "showDefault",
-                       "showSilent",
-                       "scaleWidth",
-                       "scaleHeight",
-                       "scaleGravity",
-                       "ignoreGravity",
-                       "foregroundGravity",
-                       "tileMode",
-                       "targetActivity",
-                       "alwaysRetainTaskState",
-                       "allowTaskReparenting",
-                       "searchButtonText",
-                       "colorForegroundInverse",
-                       "textAppearanceButton",
-                       "listSeparatorTextViewStyle",
-                       "streamType",
-                       "clipOrientation",
-                       "centerColor",
-                       "minSdkVersion",
-                       "windowFullscreen",
-                       "unselectedAlpha",
-                       "progressBarStyleSmallTitle",
-                       "ratingBarStyleIndicator",
-                       "apiKey",
-                       "textColorTertiary",
-                       "textColorTertiaryInverse",
-                       "listDivider",
-                       "soundEffectsEnabled",
-                       "keepScreenOn",
-                       "lineSpacingExtra",
-                       "lineSpacingMultiplier",
-                       "listChoiceIndicatorSingle",
-                       "listChoiceIndicatorMultiple",
-                       "versionCode",
-                       "versionName",
-                       "marqueeRepeatLimit",
-                       "windowNoDisplay",
-                       "backgroundDimEnabled",
-                       "inputType",
-                       "isDefault",
-                       "windowDisablePreview",
-                       "privateImeOptions",
-                       "editorExtras",
-                       "settingsActivity",
-                       "fastScrollEnabled",
-                       "reqTouchScreen",
-                       "reqKeyboardType",
-                       "reqHardKeyboard",
-                       "reqNavigation",
-                       "windowSoftInputMode",
-                       "imeFullscreenBackground",
-                       "noHistory",
-                       "headerDividersEnabled",
-                       "footerDividersEnabled",
-                       "candidatesTextStyleSpans",
-                       "smoothScrollbar",
-                       "reqFiveWayNav",
-                       "keyBackground",
-                       "keyTextSize",
-                       "labelTextSize",
-                       "keyTextColor",
-                       "keyPreviewLayout",
-                       "keyPreviewOffset",
-                       "keyPreviewHeight",
-                       "verticalCorrection",
-                       "popupLayout",
-                       "state_long_pressable",
-                       "keyWidth",
-                       "keyHeight",
-                       "horizontalGap",
-                       "verticalGap",
-                       "rowEdgeFlags",
-                       "codes",
-                       "popupKeyboard",
-                       "popupCharacters",
-                       "keyEdgeFlags",
-                       "isModifier",
-                       "isSticky",
-                       "isRepeatable",
-                       "iconPreview",
-                       "keyOutputText",
-                       "keyLabel",
-                       "keyIcon",
-                       "keyboardMode",
-                       "isScrollContainer",
-                       "fillEnabled",
-                       "updatePeriodMillis",
-                       "initialLayout",
-                       "voiceSearchMode",
-                       "voiceLanguageModel",
-                       "voicePromptText",
-                       "voiceLanguage",
-                       "voiceMaxResults",
-                       "bottomOffset",
-                       "topOffset",
-                       "allowSingleTap",
-                       "handle",
-                       "content",
-                       "animateOnClick",
-                       "configure",
-                       "hapticFeedbackEnabled",
-                       "innerRadius",
-                       "thickness",
-                       "sharedUserLabel",
-                       "dropDownWidth",
-                       "dropDownAnchor",
-                       "imeOptions",
-                       "imeActionLabel",
-                       "imeActionId",
-                       "UNKNOWN",
-                       "imeExtractEnterAnimation",
-                       "imeExtractExitAnimation",
-                       "tension",
-                       "extraTension",
-                       "anyDensity",
-                       "searchSuggestThreshold",
-                       "includeInGlobalSearch",
-                       "onClick",
-                       "targetSdkVersion",
-                       "maxSdkVersion",
-                       "testOnly",
-                       "contentDescription",
-                       "gestureStrokeWidth",
-                       "gestureColor",
-                       "uncertainGestureColor",
-                       "fadeOffset",
-                       "fadeDuration",
-                       "gestureStrokeType",
-                       "gestureStrokeLengthThreshold",
-                       "gestureStrokeSquarenessThreshold",
-                       "gestureStrokeAngleThreshold",
-                       "eventsInterceptionEnabled",
-                       "fadeEnabled",
-                       "backupAgent",
-                       "allowBackup",
-                       "glEsVersion",
-                       "queryAfterZeroResults",
-                       "dropDownHeight",
-                       "smallScreens",
-                       "normalScreens",
-                       "largeScreens",
-                       "progressBarStyleInverse",
-                       "progressBarStyleSmallInverse",
-                       "progressBarStyleLargeInverse",
-                       "searchSettingsDescription",
-                       "textColorPrimaryInverseDisableOnly",
-                       "autoUrlDetect",
-                       "resizeable",
-                       "required",
-                       "accountType",
-                       "contentAuthority",
-                       "userVisible",
-                       "windowShowWallpaper",
-                       "wallpaperOpenEnterAnimation",
-                       "wallpaperOpenExitAnimation",
-                       "wallpaperCloseEnterAnimation",
-                       "wallpaperCloseExitAnimation",
-                       "wallpaperIntraOpenEnterAnimation",
-                       "wallpaperIntraOpenExitAnimation",
-                       "wallpaperIntraCloseEnterAnimation",
-                       "wallpaperIntraCloseExitAnimation",
-                       "supportsUploading",
-                       "killAfterRestore",
-                       "restoreNeedsApplication",
-                       "smallIcon",
-                       "accountPreferences",
-                       "textAppearanceSearchResultSubtitle",
-                       "textAppearanceSearchResultTitle",
-                       "summaryColumn",
-                       "detailColumn",
-                       "detailSocialSummary",
-                       "thumbnail",
-                       "detachWallpaper",
-                       "finishOnCloseSystemDialogs",
-                       "scrollbarFadeDuration",
-                       "scrollbarDefaultDelayBeforeFade",
-                       "fadeScrollbars",
-                       "colorBackgroundCacheHint",
-                       "dropDownHorizontalOffset",
-                       "dropDownVerticalOffset",
-                       "quickContactBadgeStyleWindowSmall",
-                       "quickContactBadgeStyleWindowMedium",
-                       "quickContactBadgeStyleWindowLarge",
-                       "quickContactBadgeStyleSmallWindowSmall",
-                       "quickContactBadgeStyleSmallWindowMedium",
-                       "quickContactBadgeStyleSmallWindowLarge",
-                       "author",
-                       "autoStart",
-                       "expandableListViewWhiteStyle",
-                       "installLocation",
-                       "vmSafeMode",
-                       "webTextViewStyle",
-                       "restoreAnyVersion",
-                       "tabStripLeft",
-                       "tabStripRight",
-                       "tabStripEnabled",
-                       "logo",
-                       "xlargeScreens",
-                       "immersive",
-                       "overScrollMode",
-                       "overScrollHeader",
-                       "overScrollFooter",
-                       "filterTouchesWhenObscured",
-                       "textSelectHandleLeft",
-                       "textSelectHandleRight",
-                       "textSelectHandle",
-                       "textSelectHandleWindowStyle",
-                       "popupAnimationStyle",
-                       "screenSize",
-                       "screenDensity",
-                       "allContactsName",
-                       "windowActionBar",
-                       "actionBarStyle",
-                       "navigationMode",
-                       "displayOptions",
-                       "subtitle",
-                       "customNavigationLayout",
-                       "hardwareAccelerated",
-                       "measureWithLargestChild",
-                       "animateFirstView",
-                       "dropDownSpinnerStyle",
-                       "actionDropDownStyle",
-                       "actionButtonStyle",
-                       "showAsAction",
-                       "previewImage",
-                       "actionModeBackground",
-                       "actionModeCloseDrawable",
-                       "windowActionModeOverlay",
-                       "valueFrom",
-                       "valueTo",
-                       "valueType",
-                       "propertyName",
-                       "ordering",
-                       "fragment",
-                       "windowActionBarOverlay",
-                       "fragmentOpenEnterAnimation",
-                       "fragmentOpenExitAnimation",
-                       "fragmentCloseEnterAnimation",
-                       "fragmentCloseExitAnimation",
-                       "fragmentFadeEnterAnimation",
-                       "fragmentFadeExitAnimation",
-                       "actionBarSize",
-                       "imeSubtypeLocale",
-                       "imeSubtypeMode",
-                       "imeSubtypeExtraValue",
-                       "splitMotionEvents",
-                       "listChoiceBackgroundIndicator",
-                       "spinnerMode",
-                       "animateLayoutChanges",
-                       "actionBarTabStyle",
-                       "actionBarTabBarStyle",
-                       "actionBarTabTextStyle",
-                       "actionOverflowButtonStyle",
-                       "actionModeCloseButtonStyle",
-                       "titleTextStyle",
-                       "subtitleTextStyle",
-                       "iconifiedByDefault",
-                       "actionLayout",
-                       "actionViewClass",
-                       "activatedBackgroundIndicator",
-                       "state_activated",
-                       "listPopupWindowStyle",
-                       "popupMenuStyle",
-                       "textAppearanceLargePopupMenu",
-                       "textAppearanceSmallPopupMenu",
-                       "breadCrumbTitle",
-                       "breadCrumbShortTitle",
-                       "listDividerAlertDialog",
-                       "textColorAlertDialogListItem",
-                       "loopViews",
-                       "dialogTheme",
-                       "alertDialogTheme",
-                       "dividerVertical",
-                       "homeAsUpIndicator",
-                       "enterFadeDuration",
-                       "exitFadeDuration",
-                       "selectableItemBackground",
-                       "autoAdvanceViewId",
-                       "useIntrinsicSizeAsMinimum",
-                       "actionModeCutDrawable",
-                       "actionModeCopyDrawable",
-                       "actionModePasteDrawable",
-                       "textEditPasteWindowLayout",
-                       "textEditNoPasteWindowLayout",
-                       "textIsSelectable",
-                       "windowEnableSplitTouch",
-                       "indeterminateProgressStyle",
-                       "progressBarPadding",
-                       "animationResolution",
-                       "state_accelerated",
-                       "baseline",
-                       "homeLayout",
-                       "opacity",
-                       "alpha",
-                       "transformPivotX",
-                       "transformPivotY",
-                       "translationX",
-                       "translationY",
-                       "scaleX",
-                       "scaleY",
-                       "rotation",
-                       "rotationX",
-                       "rotationY",
-                       "showDividers",
-                       "dividerPadding",
-                       "borderlessButtonStyle",
-                       "dividerHorizontal",
-                       "itemPadding",
-                       "buttonBarStyle",
-                       "buttonBarButtonStyle",
-                       "segmentedButtonStyle",
-                       "staticWallpaperPreview",
-                       "allowParallelSyncs",
-                       "isAlwaysSyncable",
-                       "verticalScrollbarPosition",
-                       "fastScrollAlwaysVisible",
-                       "fastScrollThumbDrawable",
-                       "fastScrollPreviewBackgroundLeft",
-                       "fastScrollPreviewBackgroundRight",
-                       "fastScrollTrackDrawable",
-                       "fastScrollOverlayPosition",
-                       "customTokens",
-                       "nextFocusForward",
-                       "firstDayOfWeek",
-                       "showWeekNumber",
-                       "minDate",
-                       "maxDate",
-                       "shownWeekCount",
-                       "selectedWeekBackgroundColor",
-                       "focusedMonthDateColor",
-                       "unfocusedMonthDateColor",
-                       "weekNumberColor",
-                       "weekSeparatorLineColor",
-                       "selectedDateVerticalBar",
-                       "weekDayTextAppearance",
-                       "dateTextAppearance",
-                       "UNKNOWN",
-                       "spinnersShown",
-                       "calendarViewShown",
-                       "state_multiline",
-                       "detailsElementBackground",
-                       "textColorHighlightInverse",
-                       "textColorLinkInverse",
-                       "editTextColor",
-                       "editTextBackground",
-                       "horizontalScrollViewStyle",
-                       "layerType",
-                       "alertDialogIcon",
-                       "windowMinWidthMajor",
-                       "windowMinWidthMinor",
-                       "queryHint",
-                       "fastScrollTextColor",
-                       "largeHeap",
-                       "windowCloseOnTouchOutside",
-                       "datePickerStyle",
-                       "calendarViewStyle",
-                       "textEditSidePasteWindowLayout",
-                       "textEditSideNoPasteWindowLayout",
-                       "actionMenuTextAppearance",
-                       "actionMenuTextColor",
-                       "textCursorDrawable",
-                       "resizeMode",
-                       "requiresSmallestWidthDp",
-                       "compatibleWidthLimitDp",
-                       "largestWidthLimitDp",
-                       "state_hovered",
-                       "state_drag_can_accept",
-                       "state_drag_hovered",
-                       "stopWithTask",
-                       "switchTextOn",
-                       "switchTextOff",
-                       "switchPreferenceStyle",
-                       "switchTextAppearance",
-                       "track",
-                       "switchMinWidth",
-                       "switchPadding",
-                       "thumbTextPadding",
-                       "textSuggestionsWindowStyle",
-                       "textEditSuggestionItemLayout",
-                       "rowCount",
-                       "rowOrderPreserved",
-                       "columnCount",
-                       "columnOrderPreserved",
-                       "useDefaultMargins",
-                       "alignmentMode",
-                       "layout_row",
-                       "layout_rowSpan",
-                       "layout_columnSpan",
-                       "actionModeSelectAllDrawable",
-                       "isAuxiliary",
-                       "accessibilityEventTypes",
-                       "packageNames",
-                       "accessibilityFeedbackType",
-                       "notificationTimeout",
-                       "accessibilityFlags",
-                       "canRetrieveWindowContent",
-                       "listPreferredItemHeightLarge",
-                       "listPreferredItemHeightSmall",
-                       "actionBarSplitStyle",
-                       "actionProviderClass",
-                       "backgroundStacked",
-                       "backgroundSplit",
-                       "textAllCaps",
-                       "colorPressedHighlight",
-                       "colorLongPressedHighlight",
-                       "colorFocusedHighlight",
-                       "colorActivatedHighlight",
-                       "colorMultiSelectHighlight",
-                       "drawableStart",
-                       "drawableEnd",
-                       "actionModeStyle",
-                       "minResizeWidth",
-                       "minResizeHeight",
-                       "actionBarWidgetTheme",
-                       "uiOptions",
-                       "subtypeLocale",
-                       "subtypeExtraValue",
-                       "actionBarDivider",
-                       "actionBarItemBackground",
-                       "actionModeSplitBackground",
-                       "textAppearanceListItem",
-                       "textAppearanceListItemSmall",
-                       "targetDescriptions",
-                       "directionDescriptions",
-                       "overridesImplicitlyEnabledSubtype",
-                       "listPreferredItemPaddingLeft",
-                       "listPreferredItemPaddingRight",
-                       "requiresFadingEdge",
-                       "publicKey",
-                       "parentActivityName",
-                       "UNKNOWN",
-                       "isolatedProcess",
-                       "importantForAccessibility",
-                       "keyboardLayout",
-                       "fontFamily",
-                       "mediaRouteButtonStyle",
-                       "mediaRouteTypes",
-                       "supportsRtl",
-                       "textDirection",
-                       "textAlignment",
-                       "layoutDirection",
-                       "paddingStart",
-                       "paddingEnd",
-                       "layout_marginStart",
-                       "layout_marginEnd",
-                       "layout_toStartOf",
-                       "layout_toEndOf",
-                       "layout_alignStart",
-                       "layout_alignEnd",
-                       "layout_alignParentStart",
-                       "layout_alignParentEnd",
-                       "listPreferredItemPaddingStart",
-                       "listPreferredItemPaddingEnd",
-                       "singleUser",
-                       "presentationTheme",
-                       "subtypeId",
-                       "initialKeyguardLayout",
-                       "UNKNOWN",
-                       "widgetCategory",
-                       "permissionGroupFlags",
-                       "labelFor",
-                       "permissionFlags",
-                       "checkedTextViewStyle",
-                       "showOnLockScreen",
-                       "format12Hour",
-                       "format24Hour",
-                       "timeZone",
-                       "mipMap",
-                       "mirrorForRtl",
-                       "windowOverscan",
-                       "requiredForAllUsers",
-                       "indicatorStart",
-                       "indicatorEnd",
-                       "childIndicatorStart",
-                       "childIndicatorEnd",
-                       "restrictedAccountType",
-                       "requiredAccountType",
-                       "canRequestTouchExplorationMode",
-                       "canRequestEnhancedWebAccessibility",
-                       "canRequestFilterKeyEvents",
-                       "layoutMode",
-                       "keySet",
-                       "targetId",
-                       "fromScene",
-                       "toScene",
-                       "transition",
-                       "transitionOrdering",
-                       "fadingMode",
-                       "startDelay",
-                       "ssp",
-                       "sspPrefix",
-                       "sspPattern",
-                       "addPrintersActivity",
-                       "vendor",
-                       "category",
-                       "isAsciiCapable",
-                       "autoMirrored",
-                       "supportsSwitchingToNextInputMethod",
-                       "requireDeviceUnlock",
-                       "apduServiceBanner",
-                       "accessibilityLiveRegion",
-                       "windowTranslucentStatus",
-                       "windowTranslucentNavigation",
-                       "advancedPrintOptionsActivity",
-                       "banner",
-                       "windowSwipeToDismiss",
-                       "isGame",
-                       "allowEmbedded",
-                       "setupActivity",
-                       "fastScrollStyle",
-                       "windowContentTransitions",
-                       "windowContentTransitionManager",
-                       "translationZ",
-                       "tintMode",
-                       "controlX1",
-                       "controlY1",
-                       "controlX2",
-                       "controlY2",
-                       "transitionName",
-                       "transitionGroup",
-                       "viewportWidth",
-                       "viewportHeight",
-                       "fillColor",
-                       "pathData",
-                       "strokeColor",
-                       "strokeWidth",
-                       "trimPathStart",
-                       "trimPathEnd",
-                       "trimPathOffset",
-                       "strokeLineCap",
-                       "strokeLineJoin",
-                       "strokeMiterLimit",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "colorControlNormal",
-                       "colorControlActivated",
-                       "colorButtonNormal",
-                       "colorControlHighlight",
-                       "persistableMode",
-                       "titleTextAppearance",
-                       "subtitleTextAppearance",
-                       "slideEdge",
-                       "actionBarTheme",
-                       "textAppearanceListItemSecondary",
-                       "colorPrimary",
-                       "colorPrimaryDark",
-                       "colorAccent",
-                       "nestedScrollingEnabled",
-                       "windowEnterTransition",
-                       "windowExitTransition",
-                       "windowSharedElementEnterTransition",
-                       "windowSharedElementExitTransition",
-                       "windowAllowReturnTransitionOverlap",
-                       "windowAllowEnterTransitionOverlap",
-                       "sessionService",
-                       "stackViewStyle",
-                       "switchStyle",
-                       "elevation",
-                       "excludeId",
-                       "excludeClass",
-                       "hideOnContentScroll",
-                       "actionOverflowMenuStyle",
-                       "documentLaunchMode",
-                       "maxRecents",
-                       "autoRemoveFromRecents",
-                       "stateListAnimator",
-                       "toId",
-                       "fromId",
-                       "reversible",
-                       "splitTrack",
-                       "targetName",
-                       "excludeName",
-                       "matchOrder",
-                       "windowDrawsSystemBarBackgrounds",
-                       "statusBarColor",
-                       "navigationBarColor",
-                       "contentInsetStart",
-                       "contentInsetEnd",
-                       "contentInsetLeft",
-                       "contentInsetRight",
-                       "paddingMode",
-                       "layout_rowWeight",
-                       "layout_columnWeight",
-                       "translateX",
-                       "translateY",
-                       "selectableItemBackgroundBorderless",
-                       "elegantTextHeight",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "UNKNOWN",
-                       "windowTransitionBackgroundFadeDuration",
-                       "overlapAnchor",
-                       "progressTint",
-                       "progressTintMode",
-                       "progressBackgroundTint",
-                       "progressBackgroundTintMode",
-                       "secondaryProgressTint",
-                       "secondaryProgressTintMode",
-                       "indeterminateTint",
-                       "indeterminateTintMode",
-                       "backgroundTint",
-                       "backgroundTintMode",
-                       "foregroundTint",
-                       "foregroundTintMode",
-                       "buttonTint",
-                       "buttonTintMode",
-                       "thumbTint",
-                       "thumbTintMode",
-                       "fullBackupOnly",
-                       "propertyXName",
-                       "propertyYName",
-                       "relinquishTaskIdentity",
-                       "tileModeX",
-                       "tileModeY",
-                       "actionModeShareDrawable",
-                       "actionModeFindDrawable",
-                       "actionModeWebSearchDrawable",
-                       "transitionVisibilityMode",
-                       "minimumHorizontalAngle",
-                       "minimumVerticalAngle",
-                       "maximumAngle",
-                       "searchViewStyle",
-                       "closeIcon",
-                       "goIcon",
-                       "searchIcon",
-                       "voiceIcon",
-                       "commitIcon",
-                       "suggestionRowLayout",
-                       "queryBackground",
-                       "submitBackground",
-                       "buttonBarPositiveButtonStyle",
-                       "buttonBarNeutralButtonStyle",
-                       "buttonBarNegativeButtonStyle",
-                       "popupElevation",
-                       "actionBarPopupTheme",
-                       "multiArch",
-                       "touchscreenBlocksFocus",
-                       "windowElevation",
-                       "launchTaskBehindTargetAnimation",
-                       "launchTaskBehindSourceAnimation",
-                       "restrictionType",
-                       "dayOfWeekBackground",
-                       "dayOfWeekTextAppearance",
-                       "headerMonthTextAppearance",
-                       "headerDayOfMonthTextAppearance",
-                       "headerYearTextAppearance",
-                       "yearListItemTextAppearance",
-                       "yearListSelectorColor",
-                       "calendarTextColor",
-                       "recognitionService",
-                       "timePickerStyle",
-                       "timePickerDialogTheme",
-                       "headerTimeTextAppearance",
-                       "headerAmPmTextAppearance",
-                       "numbersTextColor",
-                       "numbersBackgroundColor",
-                       "numbersSelectorColor",
-                       "amPmTextColor",
-                       "amPmBackgroundColor",
-                       "UNKNOWN",
-                       "checkMarkTint",
-                       "checkMarkTintMode",
-                       "popupTheme",
-                       "toolbarStyle",
-                       "windowClipToOutline",
-                       "datePickerDialogTheme",
-                       "showText",
-                       "windowReturnTransition",
-                       "windowReenterTransition",
-                       "windowSharedElementReturnTransition",
-                       "windowSharedElementReenterTransition",
-                       "resumeWhilePausing",
-                       "datePickerMode",
-                       "timePickerMode",
-                       "inset",
-                       "letterSpacing",
-                       "fontFeatureSettings",
-                       "outlineProvider",
-                       "contentAgeHint",
-                       "country",
-                       "windowSharedElementsUseOverlay",
-                       "reparent",
-                       "reparentWithOverlay",
-                       "ambientShadowAlpha",
-                       "spotShadowAlpha",
-                       "navigationIcon",
-                       "navigationContentDescription",
-                       "fragmentExitTransition",
-                       "fragmentEnterTransition",
-                       "fragmentSharedElementEnterTransition",
-                       "fragmentReturnTransition",
-                       "fragmentSharedElementReturnTransition",
-                       "fragmentReenterTransition",
-                       "fragmentAllowEnterTransitionOverlap",
-                       "fragmentAllowReturnTransitionOverlap",
-                       "patternPathData",
-                       "strokeAlpha",
-                       "fillAlpha",
-                       "windowActivityTransitions",
-                       "colorEdgeEffect",
-                       "resizeClip",
-                       "collapseContentDescription",
-                       "accessibilityTraversalBefore",
-                       "accessibilityTraversalAfter",
-                       "dialogPreferredPadding",
-                       "searchHintIcon",
-                       "revisionCode",
-                       "drawableTint",
-                       "drawableTintMode",
-                       "fraction",
-                       "trackTint",
-                       "trackTintMode",
-                       "start",
-                       "end",
-                       "breakStrategy",
-                       "hyphenationFrequency",
-                       "allowUndo",
-                       "windowLightStatusBar",
-                       "numbersInnerTextColor",
-                       "colorBackgroundFloating",
-                       "titleTextColor",
-                       "subtitleTextColor",
-                       "thumbPosition",
-                       "scrollIndicators",
-                       "contextClickable",
-                       "fingerprintAuthDrawable",
-                       "logoDescription",
-                       "extractNativeLibs",
-                       "fullBackupContent",
-                       "usesCleartextTraffic",
-                       "lockTaskMode",
-                       "autoVerify",
-                       "showForAllUsers",
-                       "supportsAssist",
-                       "supportsLaunchVoiceAssistFromKeyguard",
-                       "listMenuViewStyle",
-                       "subMenuArrow",
-                       "defaultWidth",
-                       "defaultHeight",
-                       "resizeableActivity",
-                       "supportsPictureInPicture",
-                       "titleMargin",
-                       "titleMarginStart",
-                       "titleMarginEnd",
-                       "titleMarginTop",
-                       "titleMarginBottom",
-                       "maxButtonHeight",
-                       "buttonGravity",
-                       "collapseIcon",
-                       "level",
-                       "contextPopupMenuStyle",
-                       "textAppearancePopupMenuHeader",
-                       "windowBackgroundFallback",
-                       "defaultToDeviceProtectedStorage",
-                       "directBootAware",
-                       "preferenceFragmentStyle",
-                       "canControlMagnification",
-                       "languageTag",
-                       "pointerIcon",
-                       "tickMark",
-                       "tickMarkTint",
-                       "tickMarkTintMode",
-                       "canPerformGestures",
-                       "externalService",
-                       "supportsLocalInteraction",
-                       "startX",
-                       "startY",
-                       "endX",
-                       "endY",
-                       "offset",
-                       "use32bitAbi",
-                       "bitmap",
-                       "hotSpotX",
-                       "hotSpotY",
-                       "version",
-                       "backupInForeground",
-                       "countDown",
-                       "canRecord",
-                       "tunerCount",
-                       "fillType",
-                       "popupEnterTransition",
-                       "popupExitTransition",
-                       "forceHasOverlappingRendering",
-                       "contentInsetStartWithNavigation",
-                       "contentInsetEndWithActions",
-                       "numberPickerStyle",
-                       "enableVrMode",
-                       "UNKNOWN",
-                       "networkSecurityConfig",
-                       "shortcutId",
-                       "shortcutShortLabel",
-                       "shortcutLongLabel",
-                       "shortcutDisabledMessage",
-                       "roundIcon",
-                       "contextUri",
-                       "contextDescription",
-                       "showMetadataInPreview",
-                       "colorSecondary"};
-
-            // For now, we only care about the attribute names.
-            id -= 0x1010000;
-            if (id >= sizeof(attr_names) / sizeof(attr_names[0])) {
-                throw axml_parser_error("invalid resource id");
+            if (const auto* attr_name = android_attr_name(id)) {
+                name += attr_name;
+                return;
             }
-            return attr_names[id];
+
+            // Use the resource ID if the name is unknown.
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), "attr_0x%08x", id);
+            name += buf;
         }
 
     private:
-        stream_reader& reader_;
-        std::vector<std::string> strings_;
-        boost::property_tree::ptree& pt_;
+        /// The reader of the current chunk.
+        stream_reader reader_;
+        axml_handler* handler_;
+
+        /// The resource table to resolve the references, if any.
+        const resource_table* table_ = nullptr;
+
+        /// The statistics to collect into, if any.
+        decode_stats* stats_ = nullptr;
+
+        /// The copy of the string pool read from a transient chunk.
+        std::vector<uint8_t> owned_string_pool_;
+
+        /// The buffer reused to format the attribute values.
+        std::string value_buffer_;
+
+        /// The attribute names with the prefixes keyed by the string indices
+        /// of the prefix and the name.
+        std::unordered_map<uint64_t, std::string> qualified_names_;
+
+        /// The string pool chunk and the strings decoded so far.
+        stream_reader string_pool_;
+        bool string_pool_utf8_ = false;
+        uint32_t string_offsets_start_ = 0;
+        uint32_t strings_start_ = 0;
+        std::vector<boost::string_ref> strings_;
+        std::vector<bool> string_decoded_;
+        std::unique_ptr<char[]> string_arena_;
+        size_t string_arena_size_ = 0;
+        size_t string_arena_capacity_ = 0;
+        size_t string_arena_allocated_ = 0;
+        std::deque<std::string> string_arena_overflow_;
+
+        /// The namespaces in scope. The elements own the ones after their
+        /// offsets in namespace_frames_, and namespace_by_uri_ maps each URI
+        /// to the innermost one.
+        struct namespace_entry {
+            uint32_t prefix;
+            uint32_t uri;
+            size_t shadowed;
+        };
+        static constexpr size_t no_namespace = static_cast<size_t>(-1);
+        std::vector<namespace_entry> namespaces_;
+        std::vector<size_t> namespace_frames_;
+        std::vector<size_t> namespace_by_uri_;
+    };
 
-        struct xml_stack_item {
-            boost::property_tree::ptree* pt;
-            std::vector<std::pair<uint32_t, uint32_t>> namespaces;
+    constexpr size_t axml_parser::no_namespace;
 
-            explicit xml_stack_item(boost::property_tree::ptree* pt) : pt(pt)
-            {
+    /// A handler building boost::property_tree::ptree from the binary XML.
+    ///
+    /// The children are appended directly instead of going through the
+    /// paths. The resulting tree is the same as the one built with
+    /// ptree::add() using '`' as the separator.
+    class axml_ptree_builder : public axml_handler {
+    public:
+        explicit axml_ptree_builder(boost::property_tree::ptree& pt)
+        {
+            xml_stack_.push_back({&pt, nullptr, 0});
+        }
+
+        void start_namespace(boost::string_ref prefix,
+                             boost::string_ref uri) override
+        {
+            namespaces_.emplace_back("xmlns:" + prefix.to_string(),
+                                     uri.to_string());
+        }
+
+        void end_namespace(boost::string_ref /*prefix*/,
+                           boost::string_ref /*uri*/) override
+        {
+            if (namespaces_.size() > xml_stack_.back().namespace_offset) {
+                namespaces_.pop_back();
+            }
+        }
+
+        void start_element(boost::string_ref name) override
+        {
+            // Create ptree for the new element.
+            const auto& parent = xml_stack_.back();
+            auto namespace_offset = parent.namespace_offset;
+            auto* elem_pt = &add_child(*parent.pt, name.to_string(),
+                                       std::string());
+            xml_stack_.push_back({elem_pt, nullptr, namespaces_.size()});
+            for (size_t i = namespace_offset; i < namespaces_.size(); ++i) {
+                add_attribute(namespaces_[i].first, namespaces_[i].second);
+            }
+        }
+
+        void attribute(boost::string_ref name, boost::string_ref value) override
+        {
+            add_attribute(name.to_string(), value.to_string());
+        }
+
+        void end_element(boost::string_ref /*name*/) override
+        {
+            // Keep the document at the bottom when the end elements do not
+            // match the start elements.
+            if (xml_stack_.size() < 2) {
+                return;
+            }
+            namespaces_.resize(xml_stack_.back().namespace_offset);
+            xml_stack_.pop_back();
+        }
+
+        void cdata(boost::string_ref text) override
+        {
+            xml_stack_.back().pt->push_back(
+                    {"<xmltext>", ptree(text.to_string())});
+        }
+
+    private:
+        using ptree = boost::property_tree::ptree;
+        using path_type = ptree::path_type;
+
+        /// Appends the child. A key containing the separator is added
+        /// through the path to keep the tree the same as before.
+        static ptree& add_child(ptree& pt, std::string key, std::string data)
+        {
+            if (key.find('`') != std::string::npos) {
+                return pt.add(path_type(key, '`'), data);
             }
+            return pt.push_back({std::move(key), ptree(std::move(data))})
+                    ->second;
+        }
+
+        void add_attribute(std::string name, std::string value)
+        {
+            // Create the attributes of the element when the first one is
+            // found.
+            auto& elem = xml_stack_.back();
+            if (!elem.attrs) {
+                auto it = elem.pt->find("<xmlattr>");
+                if (it != elem.pt->not_found()) {
+                    elem.attrs = &it->second;
+                }
+                else {
+                    elem.attrs = &elem.pt->push_back({"<xmlattr>", ptree()})
+                                          ->second;
+                }
+            }
+            add_child(*elem.attrs, std::move(name), std::move(value));
+        }
+
+    private:
+        /// The open elements. Each element owns the namespaces after its
+        /// namespace_offset.
+        struct xml_stack_item {
+            ptree* pt;
+            ptree* attrs;
+            size_t namespace_offset;
         };
         std::vector<xml_stack_item> xml_stack_;
+
+        /// The xmlns attributes of the namespaces declared.
+        std::vector<std::pair<std::string, std::string>> namespaces_;
     };
 }
 
 void jitana::read_axml(const std::string& filename,
                        boost::property_tree::ptree& pt)
+{
+    axml_ptree_builder builder(pt);
+    read_axml(filename, builder);
+}
+
+void jitana::read_axml(std::istream& stream, boost::property_tree::ptree& pt)
+{
+    axml_ptree_builder builder(pt);
+    read_axml(stream, builder);
+}
+
+void jitana::read_axml(const void* first, const void* last,
+                       boost::property_tree::ptree& pt)
+{
+    axml_ptree_builder builder(pt);
+    read_axml(first, last, builder);
+}
+
+void jitana::read_axml(const std::string& filename, axml_handler& handler)
 {
     boost::iostreams::mapped_file file(filename);
 
-    stream_reader reader(file.begin(), file.end());
-    axml_parser p(reader, pt);
-    p.parse();
+    axml_parser p(handler);
+    p.parse(file.begin(), file.end());
 }
 
-void jitana::read_axml(std::istream& stream, boost::property_tree::ptree& pt)
+void jitana::read_axml(std::istream& stream, axml_handler& handler)
+{
+    axml_push_parser p(handler);
+    std::vector<char> buffer(1 << 16);
+    while (stream) {
+        stream.read(buffer.data(), buffer.size());
+        p.feed(buffer.data(), static_cast<size_t>(stream.gcount()));
+    }
+    p.finish();
+}
+
+void jitana::read_axml(const void* first, const void* last,
+                       axml_handler& handler)
+{
+    axml_parser p(handler);
+    p.parse(first, last);
+}
+
+void jitana::read_axml(const void* first, const void* last,
+                       axml_handler& handler, const resource_table& table)
+{
+    axml_parser p(handler);
+    p.set_resource_table(&table);
+    p.parse(first, last);
+}
+
+axml_reader::axml_reader() : parser_(new axml_parser(null_handler_))
+{
+}
+
+axml_reader::~axml_reader() = default;
+
+void axml_reader::set_resource_table(const resource_table* table)
+{
+    parser_->set_resource_table(table);
+}
+
+void axml_reader::set_stats(decode_stats* stats)
+{
+    parser_->set_stats(stats);
+}
+
+void axml_reader::read(const void* first, const void* last,
+                       axml_handler& handler)
+{
+    // Do not leave the handler referenced after the document.
+    parser_->set_handler(handler);
+    try {
+        parser_->parse(first, last);
+    }
+    catch (...) {
+        parser_->set_handler(null_handler_);
+        throw;
+    }
+    parser_->set_handler(null_handler_);
+}
+
+axml_push_parser::axml_push_parser(axml_handler& handler,
+                                   const resource_table* table)
+        : parser_(new axml_parser(handler))
+{
+    parser_->set_resource_table(table);
+}
+
+axml_push_parser::~axml_push_parser() = default;
+
+void axml_push_parser::feed(const void* data, size_t size)
+{
+    const auto* first = static_cast<const uint8_t*>(data);
+    const auto* last = first + size;
+    if (done()) {
+        return;
+    }
+
+    // Complete the chunk left from the previous data.
+    if (!buffer_.empty()) {
+        const size_t header_size = sizeof(axml_parser::res_chunk_header);
+        if (buffer_.size() < header_size) {
+            auto n = std::min<size_t>(header_size - buffer_.size(),
+                                      last - first);
+            buffer_.insert(buffer_.end(), first, first + n);
+            first += n;
+            if (buffer_.size() < header_size) {
+                return;
+            }
+        }
+
+        auto n = std::min<size_t>(unit_size(buffer_.data()) - buffer_.size(),
+                                  last - first);
+        buffer_.insert(buffer_.end(), first, first + n);
+        first += n;
+        if (buffer_.size() < unit_size(buffer_.data())) {
+            return;
+        }
+
+        parse_unit(buffer_.data(), buffer_.data() + buffer_.size());
+        buffer_.clear();
+    }
+
+    // Parse the complete chunks without copying them, and keep the rest.
+    while (first != last && !done()) {
+        if (static_cast<size_t>(last - first)
+                    < sizeof(axml_parser::res_chunk_header)
+            || static_cast<size_t>(last - first) < unit_size(first)) {
+            buffer_.assign(first, last);
+            return;
+        }
+
+        auto n = unit_size(first);
+        parse_unit(first, first + n);
+        first += n;
+    }
+}
+
+void axml_push_parser::finish()
+{
+    if (!started_) {
+        throw axml_parser_not_an_axml_file("not a binary XML file");
+    }
+    if (consumed_ < doc_size_) {
+        throw axml_parser_error("unexpected end of file");
+    }
+
+    parser_->end_document();
+}
+
+void axml_push_parser::set_stats(decode_stats* stats)
+{
+    parser_->set_stats(stats);
+}
+
+size_t axml_push_parser::unit_size(const uint8_t* p) const
+{
+    // The header of the document comes first.
+    using header_type = axml_parser::res_chunk_header;
+    if (!started_) {
+        return sizeof(header_type);
+    }
+
+    header_type header;
+    std::memcpy(&header, p, sizeof(header));
+    if (header.size < sizeof(header)) {
+        throw axml_parser_error("invalid chunk size");
+    }
+    return header.size;
+}
+
+void axml_push_parser::parse_unit(const uint8_t* first, const uint8_t* last)
 {
-    std::vector<uint8_t> buffer;
-    std::for_each(std::istreambuf_iterator<char>(stream),
-                  std::istreambuf_iterator<char>(),
-                  [&buffer](const char c) { buffer.push_back(c); });
-
-    stream_reader reader(buffer.data(), buffer.data() + buffer.size());
-    axml_parser p(reader, pt);
-    p.parse();
+    if (!started_) {
+        doc_size_ = parser_->parse_document_header(first, last);
+        consumed_ = last - first;
+        started_ = true;
+    }
+    else {
+        parser_->parse_chunk(first, last, true);
+        consumed_ += last - first;
+    }
 }
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/crc32.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include <zlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JITANA_CRC32_PCLMUL 1
+#define JITANA_TARGET(x) __attribute__((target(x)))
+#include <immintrin.h>
+#endif
+
+using namespace jitana;
+
+namespace {
+    uint32_t update_scalar(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        // Let zlib do it in the pieces it can take.
+        constexpr size_t max_chunk = std::numeric_limits<uInt>::max();
+        while (size > 0) {
+            auto n = static_cast<uInt>(std::min(size, max_chunk));
+            crc = static_cast<uint32_t>(::crc32(crc, p, n));
+            p += n;
+            size -= n;
+        }
+        return crc;
+    }
+
+#ifdef JITANA_CRC32_PCLMUL
+    JITANA_TARGET("sse4.1,pclmul")
+    inline __m128i load(const uint8_t* p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    /// Multiplies the halves of x by the constants in k and adds y.
+    JITANA_TARGET("sse4.1,pclmul")
+    inline __m128i fold(__m128i x, __m128i k, __m128i y)
+    {
+        auto lo = _mm_clmulepi64_si128(x, k, 0x00);
+        auto hi = _mm_clmulepi64_si128(x, k, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(hi, lo), y);
+    }
+
+    /// Folds the 16-byte blocks with carry-less multiplication as described
+    /// in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+    /// Instruction" by Intel. The size must be a multiple of 16 and at least
+    /// 64. The CRC is passed and returned without the final inversion.
+    JITANA_TARGET("sse4.1,pclmul")
+    uint32_t fold_pclmul(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        // The constants for the reflected polynomial 0xedb88320.
+        const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+        const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+        const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+        const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+
+        // Fold 64 bytes at a time into four accumulators.
+        __m128i x1 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(crc));
+        __m128i x2 = load(p + 16);
+        __m128i x3 = load(p + 32);
+        __m128i x4 = load(p + 48);
+        p += 64;
+        size -= 64;
+        while (size >= 64) {
+            x1 = fold(x1, k1k2, load(p));
+            x2 = fold(x2, k1k2, load(p + 16));
+            x3 = fold(x3, k1k2, load(p + 32));
+            x4 = fold(x4, k1k2, load(p + 48));
+            p += 64;
+            size -= 64;
+        }
+
+        // Fold the accumulators and the rest of the blocks into 128 bits.
+        x1 = fold(x1, k3k4, x2);
+        x1 = fold(x1, k3k4, x3);
+        x1 = fold(x1, k3k4, x4);
+        while (size >= 16) {
+            x1 = fold(x1, k3k4, load(p));
+            p += 16;
+            size -= 16;
+        }
+
+        // Fold 128 bits into 64 bits.
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, mask32);
+        x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // Reduce to 32 bits with the Barrett reduction.
+        x2 = _mm_and_si128(x1, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+        x2 = _mm_and_si128(x2, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+    }
+
+    uint32_t update_pclmul(uint32_t crc, const uint8_t* p, size_t size)
+    {
+        // The folding does not pay off for short data.
+        if (size >= 64) {
+            const size_t n = size & ~static_cast<size_t>(15);
+            crc = ~fold_pclmul(~crc, p, n);
+            p += n;
+            size -= n;
+        }
+        return update_scalar(crc, p, size);
+    }
+#endif
+
+    crc32_isa detect_isa()
+    {
+#ifdef JITANA_CRC32_PCLMUL
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("pclmul")
+            && __builtin_cpu_supports("sse4.1")) {
+            return crc32_isa::pclmul;
+        }
+#endif
+        return crc32_isa::scalar;
+    }
+}
+
+crc32_isa jitana::crc32_best_isa()
+{
+    static const crc32_isa isa = detect_isa();
+    return isa;
+}
+
+uint32_t jitana::crc32_update(uint32_t crc, const void* data, size_t size)
+{
+    return crc32_update(crc, data, size, crc32_best_isa());
+}
+
+uint32_t jitana::crc32_update(uint32_t crc, const void* data, size_t size,
+                              crc32_isa isa)
+{
+    if (isa > crc32_best_isa()) {
+        isa = crc32_best_isa();
+    }
+
+    const auto* p = static_cast<const uint8_t*>(data);
+    switch (isa) {
+#ifdef JITANA_CRC32_PCLMUL
+    case crc32_isa::pclmul:
+        return update_pclmul(crc, p, size);
+#endif
+    default:
+        return update_scalar(crc, p, size);
+    }
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/decode_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
+
+using namespace jitana;
+
+namespace fs = boost::filesystem;
+namespace ipc = boost::interprocess;
+
+namespace {
+    constexpr char index_magic[8] = {'A', 'X', 'D', 'C', 'I', 'D', 'X', '1'};
+    constexpr uint32_t index_version = 1;
+
+    struct index_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t capacity;
+        uint64_t count;
+
+        /// Which data file the records refer to.
+        uint64_t data_generation;
+        uint64_t reserved[3];
+    };
+
+    /// The data file is compacted once the bytes not referenced by the
+    /// index exceed this fraction of it.
+    constexpr double max_dead_fraction = 0.5;
+
+    /// Computes the 64-bit FNV-1a hash of the path. Zero is avoided.
+    uint64_t hash_path(boost::string_ref path)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (auto c : path) {
+            h = (h ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        }
+        return h != 0 ? h : 1;
+    }
+
+    /// Returns the path of the data file of the generation. The first one is
+    /// just "data".
+    std::string data_path(const std::string& dir, uint64_t generation)
+    {
+        auto name = std::string("data");
+        if (generation != 0) {
+            name += "." + std::to_string(generation);
+        }
+        return (fs::path(dir) / name).string();
+    }
+
+    /// Returns the path of the lock file after creating it.
+    std::string lock_path(const std::string& dir)
+    {
+        auto path = (fs::path(dir) / "lock").string();
+        std::ofstream(path, std::ios::app);
+        return path;
+    }
+}
+
+decode_cache::decode_cache(const std::string& dir) : dir_(dir)
+{
+    fs::create_directories(dir_);
+
+    ipc::file_lock lock(lock_path(dir_).c_str());
+    ipc::sharable_lock<ipc::file_lock> guard(lock);
+    map_files();
+}
+
+bool decode_cache::find(const decode_cache_key& key, std::string& xml) const
+{
+    // The entries inserted are newer than the files.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pending_.find(key.path);
+        if (it != end(pending_)) {
+            const auto& k = it->second.key;
+            if (k.file_size != key.file_size || k.mtime != key.mtime
+                || k.manifest_crc32 != key.manifest_crc32
+                || k.manifest_size != key.manifest_size
+                || k.resources_crc32 != key.resources_crc32) {
+                return false;
+            }
+            xml = it->second.xml;
+            return true;
+        }
+    }
+
+    if (capacity_ == 0) {
+        return false;
+    }
+
+    // Each path has one record at most.
+    const auto h = hash_path(key.path);
+    const auto mask = capacity_ - 1;
+    for (uint64_t n = 0, i = h & mask; n < capacity_; ++n, i = (i + 1) & mask) {
+        const auto& r = records_[i];
+        if (!r.used) {
+            return false;
+        }
+        if (r.hash != h) {
+            continue;
+        }
+
+        // Make sure the record is within the data mapped.
+        const auto size = data_file_.is_open() ? data_file_.size() : 0;
+        if (r.data_offset > size || r.path_size > size - r.data_offset
+            || r.xml_size > size - r.data_offset - r.path_size) {
+            return false;
+        }
+        const auto* data = data_file_.data() + r.data_offset;
+        if (boost::string_ref(data, r.path_size) != key.path) {
+            continue;
+        }
+
+        if (r.file_size != key.file_size || r.mtime != key.mtime
+            || r.manifest_crc32 != key.manifest_crc32
+            || r.manifest_size != key.manifest_size
+            || r.resources_crc32 != key.resources_crc32) {
+            return false;
+        }
+        xml.assign(data + r.path_size, r.xml_size);
+        return true;
+    }
+    return false;
+}
+
+void decode_cache::insert(const decode_cache_key& key, boost::string_ref xml)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_[key.path] = {key, xml.to_string()};
+}
+
+void decode_cache::flush()
+{
+    if (pending_.empty()) {
+        return;
+    }
+
+    ipc::file_lock lock(lock_path(dir_).c_str());
+    ipc::scoped_lock<ipc::file_lock> guard(lock);
+
+    // Another process may have updated the files since they were mapped.
+    map_files();
+
+    // Collect the records, leaving out the ones replaced by the entries
+    // inserted.
+    const auto size = data_file_.is_open() ? data_file_.size() : 0;
+    std::unordered_map<std::string, record> records;
+    uint64_t live_size = 0;
+    for (uint64_t i = 0; i < capacity_; ++i) {
+        const auto& r = records_[i];
+        if (!r.used || r.data_offset > size
+            || r.path_size > size - r.data_offset
+            || r.xml_size > size - r.data_offset - r.path_size) {
+            continue;
+        }
+        std::string path(data_file_.data() + r.data_offset, r.path_size);
+        if (pending_.count(path) == 0) {
+            live_size += r.path_size + r.xml_size;
+            records.emplace(std::move(path), r);
+        }
+    }
+    uint64_t pending_size = 0;
+    for (const auto& kv : pending_) {
+        pending_size += kv.first.size() + kv.second.xml.size();
+    }
+
+    // The records replaced stay in the data file as dead bytes. Once they
+    // are too many, the live records are copied to the data file of the
+    // next generation instead of appending to the current one.
+    const auto dead_size = size - live_size;
+    const bool compact
+            = dead_size > max_dead_fraction * (size + pending_size);
+    const auto old_data_path = data_path(dir_, generation_);
+    auto generation = generation_;
+    uint64_t offset = 0;
+    std::ofstream ofs;
+    if (compact) {
+        ++generation;
+        ofs.open(data_path(dir_, generation),
+                 std::ios::binary | std::ios::trunc);
+        for (auto& kv : records) {
+            auto& r = kv.second;
+            ofs.write(data_file_.data() + r.data_offset,
+                      r.path_size + r.xml_size);
+            r.data_offset = offset;
+            offset += r.path_size + r.xml_size;
+        }
+    }
+    else {
+        boost::system::error_code ec;
+        offset = fs::file_size(old_data_path, ec);
+        if (ec) {
+            offset = 0;
+        }
+        ofs.open(old_data_path, std::ios::binary | std::ios::app);
+    }
+
+    // Write the new entries to the data file.
+    for (const auto& kv : pending_) {
+        const auto& e = kv.second;
+        record r;
+        std::memset(&r, 0, sizeof(r));
+        r.hash = hash_path(e.key.path);
+        r.file_size = e.key.file_size;
+        r.mtime = e.key.mtime;
+        r.manifest_size = e.key.manifest_size;
+        r.manifest_crc32 = e.key.manifest_crc32;
+        r.resources_crc32 = e.key.resources_crc32;
+        r.data_offset = offset;
+        r.path_size = static_cast<uint32_t>(e.key.path.size());
+        r.used = 1;
+        r.xml_size = e.xml.size();
+        ofs.write(e.key.path.data(), e.key.path.size());
+        ofs.write(e.xml.data(), e.xml.size());
+        offset += r.path_size + r.xml_size;
+        records[e.key.path] = r;
+    }
+    if (!ofs.flush()) {
+        throw decode_cache_error("failed to write the cache data");
+    }
+    ofs.close();
+
+    // Build the new index at most half full.
+    uint64_t capacity = 16;
+    while (capacity < records.size() * 2) {
+        capacity *= 2;
+    }
+    std::vector<record> table(capacity);
+    std::memset(table.data(), 0, capacity * sizeof(record));
+    for (const auto& kv : records) {
+        auto i = kv.second.hash & (capacity - 1);
+        while (table[i].used) {
+            i = (i + 1) & (capacity - 1);
+        }
+        table[i] = kv.second;
+    }
+
+    index_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, index_magic, sizeof(header.magic));
+    header.version = index_version;
+    header.record_size = sizeof(record);
+    header.capacity = capacity;
+    header.count = records.size();
+    header.data_generation = generation;
+
+    // Replace the index at once so that the readers see either of them.
+    const auto index_path = fs::path(dir_) / "index";
+    auto temp_path = index_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream ofs(temp_path.string(),
+                          std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(table.data()),
+                  capacity * sizeof(record));
+        if (!ofs.flush()) {
+            throw decode_cache_error("failed to write the cache index");
+        }
+    }
+    fs::rename(temp_path, index_path);
+
+    // The processes mapping the old data file keep it until they unmap it.
+    if (compact) {
+        boost::system::error_code ec;
+        fs::remove(old_data_path, ec);
+    }
+
+    pending_.clear();
+    map_files();
+}
+
+void decode_cache::map_files()
+{
+    index_file_.close();
+    data_file_.close();
+    records_ = nullptr;
+    capacity_ = 0;
+    generation_ = 0;
+
+    // A missing or broken index is the same as an empty one. The files are
+    // only replaced under the exclusive lock, so the data file named by
+    // the index covers all of its records.
+    boost::system::error_code ec;
+    const auto index_path = (fs::path(dir_) / "index").string();
+    const auto index_size = fs::file_size(index_path, ec);
+    if (ec || index_size < sizeof(index_header)) {
+        return;
+    }
+    index_file_.open(index_path);
+
+    index_header header;
+    std::memcpy(&header, index_file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, index_magic, sizeof(index_magic)) != 0
+        || header.version != index_version
+        || header.record_size != sizeof(record) || header.capacity == 0
+        || (header.capacity & (header.capacity - 1)) != 0
+        || header.capacity > (index_size - sizeof(header)) / sizeof(record)) {
+        index_file_.close();
+        return;
+    }
+
+    const auto path = data_path(dir_, header.data_generation);
+    if (fs::file_size(path, ec) > 0 && !ec) {
+        data_file_.open(path);
+    }
+    generation_ = header.data_generation;
+    records_ = reinterpret_cast<const record*>(index_file_.data()
+                                               + sizeof(header));
+    capacity_ = header.capacity;
+}
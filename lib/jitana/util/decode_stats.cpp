@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "jitana/util/decode_stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <string>
+
+// Replacing operator new makes every allocation of the program check the
+// thread local statistics, so it is only done if the program asks for it.
+#ifdef JITANA_ALLOC_STATS
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define JITANA_ALLOC_SIZE(p) malloc_usable_size(p)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define JITANA_ALLOC_SIZE(p) malloc_size(p)
+#endif
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace jitana;
+
+namespace {
+    std::string chunk_name(uint16_t type)
+    {
+        switch (type) {
+        case 0x0001:
+            return "string_pool";
+        case 0x0100:
+            return "start_namespace";
+        case 0x0101:
+            return "end_namespace";
+        case 0x0102:
+            return "start_element";
+        case 0x0103:
+            return "end_element";
+        case 0x0104:
+            return "cdata";
+        case 0x0180:
+            return "resource_map";
+        }
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "0x%04x", type);
+        return buf;
+    }
+
+    std::string format(const char* fmt, double x)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), fmt, x);
+        return buf;
+    }
+}
+
+#ifdef JITANA_ALLOC_SIZE
+
+namespace {
+    /// The statistics counting the allocations of the thread, set while an
+    /// input is decoded.
+    thread_local decode_stats* alloc_stats = nullptr;
+
+    void* allocate(size_t size)
+    {
+        for (;;) {
+            if (auto* p = std::malloc(size ? size : 1)) {
+                if (alloc_stats) {
+                    alloc_stats->count_allocation(JITANA_ALLOC_SIZE(p));
+                }
+                return p;
+            }
+            auto handler = std::get_new_handler();
+            if (!handler) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    void* allocate(size_t size, const std::nothrow_t&) noexcept
+    {
+        try {
+            return allocate(size);
+        }
+        catch (std::bad_alloc&) {
+            return nullptr;
+        }
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (p && alloc_stats) {
+            alloc_stats->count_deallocation(JITANA_ALLOC_SIZE(p));
+        }
+        std::free(p);
+    }
+}
+
+// The sizes are the ones given by the allocator, which are what the
+// allocations actually take.
+
+void* operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t& tag) noexcept
+{
+    return allocate(size, tag);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return allocate(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    deallocate(p);
+}
+
+#endif
+
+constexpr size_t decode_stats::phase_count;
+
+const char* jitana::decode_phase_name(decode_phase phase)
+{
+    static const char* const names[] = {"zip_lookup",    "inflate",
+                                        "string_pool",   "element_loop",
+                                        "serialization", "other"};
+    const auto i = static_cast<size_t>(phase);
+    return i < decode_stats::phase_count ? names[i] : "none";
+}
+
+uint64_t jitana::peak_rss_bytes()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    // In kilobytes.
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+bool decode_stats::alloc_tracking_available()
+{
+#ifdef JITANA_ALLOC_SIZE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void decode_stats::count_allocation(size_t size)
+{
+    auto& a = phase_allocs[static_cast<size_t>(running_)];
+    ++a.count;
+    a.bytes += size;
+    live_ += size;
+    a.peak_live_bytes = std::max(a.peak_live_bytes, live_);
+    input_peak_ = std::max(input_peak_, live_);
+}
+
+void decode_stats::count_deallocation(size_t size)
+{
+    // The memory allocated before the input may be freed during it, which
+    // would take the live bytes below zero.
+    live_ = live_ > size ? live_ - size : 0;
+}
+
+void decode_stats::merge(const decode_stats& x)
+{
+    for (size_t i = 0; i < phase_count; ++i) {
+        phase_ns[i] += x.phase_ns[i];
+    }
+    for (const auto& c : x.chunks) {
+        chunks[c.first] += c.second;
+    }
+    files += x.files;
+    strings += x.strings;
+    elements += x.elements;
+    attributes += x.attributes;
+    max_depth = std::max(max_depth, x.max_depth);
+    bytes_in += x.bytes_in;
+    bytes_out += x.bytes_out;
+    for (size_t i = 0; i < phase_count; ++i) {
+        for (size_t j = 0; j < perf_counters::event_count; ++j) {
+            phase_events[i][j] += x.phase_events[i][j];
+        }
+    }
+    for (size_t j = 0; j < perf_counters::event_count; ++j) {
+        events_counted[j] = events_counted[j] || x.events_counted[j];
+    }
+    counters_enabled_ = counters_enabled_ || x.counters_enabled_;
+    for (size_t i = 0; i < phase_count; ++i) {
+        auto& a = phase_allocs[i];
+        const auto& b = x.phase_allocs[i];
+        a.count += b.count;
+        a.bytes += b.bytes;
+        a.peak_live_bytes = std::max(a.peak_live_bytes, b.peak_live_bytes);
+    }
+    peak_live_bytes = std::max(peak_live_bytes, x.peak_live_bytes);
+    peak_rss = std::max(peak_rss, x.peak_rss);
+    allocs_enabled_ = allocs_enabled_ || x.allocs_enabled_;
+}
+
+void decode_stats::write_text(std::ostream& os) const
+{
+    const auto total = std::accumulate(begin(phase_ns), end(phase_ns),
+                                       uint64_t(0));
+    auto row = [&](const char* name, uint64_t ns) {
+        char buf[80];
+        std::snprintf(buf, sizeof(buf), "  %-16s %12.3f ms %6.1f%%\n", name,
+                      ns / 1e6, total ? 100.0 * ns / total : 0.0);
+        os << buf;
+    };
+
+    os << "decode statistics (" << files << " files):\n";
+    for (size_t i = 0; i < phase_count; ++i) {
+        row(decode_phase_name(static_cast<decode_phase>(i)), phase_ns[i]);
+    }
+    row("total", total);
+    os << "  bytes in " << bytes_in << ", bytes out " << bytes_out << "\n";
+    os << "  strings " << strings << ", elements " << elements
+       << ", attributes " << attributes << ", max depth " << max_depth
+       << "\n";
+    os << "  chunks:";
+    for (const auto& c : chunks) {
+        os << " " << chunk_name(c.first) << " " << c.second;
+    }
+    os << "\n";
+    if (peak_rss) {
+        os << "  peak rss " << peak_rss << " bytes\n";
+    }
+    if (allocs_enabled_) {
+        write_allocs_text(os);
+    }
+
+    if (!counters_enabled_) {
+        return;
+    }
+    if (std::none_of(begin(events_counted), end(events_counted),
+                     [](bool b) { return b; })) {
+        os << "  hardware counters are unavailable\n";
+        return;
+    }
+
+    // The events not counted are shown as "-".
+    const auto cycles = static_cast<size_t>(perf_event::cycles);
+    const auto instructions = static_cast<size_t>(perf_event::instructions);
+    auto events_row = [&](const char* name, const perf_counters::values& v) {
+        char buf[120];
+        os << "  " << name;
+        for (size_t j = 0; j < perf_counters::event_count; ++j) {
+            if (events_counted[j]) {
+                std::snprintf(buf, sizeof(buf), " %14llu",
+                              static_cast<unsigned long long>(v[j]));
+            }
+            else {
+                std::snprintf(buf, sizeof(buf), " %14s", "-");
+            }
+            os << buf;
+        }
+        if (events_counted[cycles] && events_counted[instructions]
+            && v[cycles] != 0) {
+            std::snprintf(buf, sizeof(buf), " %6.2f",
+                          double(v[instructions]) / v[cycles]);
+            os << buf;
+        }
+        os << "\n";
+    };
+
+    char buf[120];
+    std::snprintf(buf, sizeof(buf), "  %-16s", "counters");
+    os << buf;
+    for (size_t j = 0; j < perf_counters::event_count; ++j) {
+        std::snprintf(buf, sizeof(buf), " %14s",
+                      perf_event_name(static_cast<perf_event>(j)));
+        os << buf;
+    }
+    os << "    ipc\n";
+    perf_counters::values total_events = {};
+    for (size_t i = 0; i < phase_count; ++i) {
+        std::snprintf(buf, sizeof(buf), "%-16s",
+                      decode_phase_name(static_cast<decode_phase>(i)));
+        events_row(buf, phase_events[i]);
+        for (size_t j = 0; j < perf_counters::event_count; ++j) {
+            total_events[j] += phase_events[i][j];
+        }
+    }
+    std::snprintf(buf, sizeof(buf), "%-16s", "total");
+    events_row(buf, total_events);
+}
+
+void decode_stats::write_json(std::ostream& os) const
+{
+    const auto total = std::accumulate(begin(phase_ns), end(phase_ns),
+                                       uint64_t(0));
+    os << "{\"files\":" << files << ",\"phases_ms\":{";
+    for (size_t i = 0; i < phase_count; ++i) {
+        os << "\"" << decode_phase_name(static_cast<decode_phase>(i))
+           << "\":" << format("%.3f", phase_ns[i] / 1e6) << ",";
+    }
+    os << "\"total\":" << format("%.3f", total / 1e6) << "}";
+    os << ",\"bytes_in\":" << bytes_in << ",\"bytes_out\":" << bytes_out;
+    os << ",\"strings\":" << strings << ",\"elements\":" << elements
+       << ",\"attributes\":" << attributes << ",\"max_depth\":" << max_depth;
+    os << ",\"chunks\":{";
+    const char* sep = "";
+    for (const auto& c : chunks) {
+        os << sep << "\"" << chunk_name(c.first) << "\":" << c.second;
+        sep = ",";
+    }
+    os << "}";
+    if (peak_rss) {
+        os << ",\"peak_rss_bytes\":" << peak_rss;
+    }
+
+    // The allocations are null if enabled but unavailable.
+    if (allocs_enabled_) {
+        os << ",\"allocations\":";
+        if (!alloc_tracking_available()) {
+            os << "null";
+        }
+        else {
+            os << "{";
+            for (size_t i = 0; i < phase_count; ++i) {
+                const auto& a = phase_allocs[i];
+                os << (i ? "," : "") << "\""
+                   << decode_phase_name(static_cast<decode_phase>(i))
+                   << "\":{\"count\":" << a.count << ",\"bytes\":" << a.bytes
+                   << ",\"peak_live_bytes\":" << a.peak_live_bytes << "}";
+            }
+            os << "},\"peak_live_bytes\":" << peak_live_bytes;
+        }
+    }
+
+    // The counters are null if enabled but unavailable.
+    if (counters_enabled_) {
+        os << ",\"counters\":";
+        if (std::none_of(begin(events_counted), end(events_counted),
+                         [](bool b) { return b; })) {
+            os << "null";
+        }
+        else {
+            os << "{";
+            for (size_t i = 0; i < phase_count; ++i) {
+                os << (i ? "," : "") << "\""
+                   << decode_phase_name(static_cast<decode_phase>(i))
+                   << "\":{";
+                sep = "";
+                for (size_t j = 0; j < perf_counters::event_count; ++j) {
+                    if (events_counted[j]) {
+                        os << sep << "\""
+                           << perf_event_name(static_cast<perf_event>(j))
+                           << "\":" << phase_events[i][j];
+                        sep = ",";
+                    }
+                }
+                os << "}";
+            }
+            os << "}";
+        }
+    }
+    os << "}\n";
+}
+
+decode_phase decode_stats::switch_phase(decode_phase phase)
+{
+    const auto now = clock::now();
+    if (running_ != decode_phase::count) {
+        phase_ns[static_cast<size_t>(running_)]
+                += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           now - running_since_)
+                           .count();
+    }
+    running_since_ = now;
+    if (counters_enabled_) {
+        switch_counters();
+    }
+    if (allocs_enabled_) {
+        switch_allocs(phase);
+    }
+
+    const auto previous = running_;
+    running_ = phase;
+    return previous;
+}
+
+void decode_stats::switch_counters()
+{
+    // Opened here rather than by enable_counters() to count the thread
+    // running the phases.
+    if (!counters_) {
+        counters_.reset(new perf_counters);
+        for (size_t j = 0; j < perf_counters::event_count; ++j) {
+            events_counted[j] = counters_->counts(static_cast<perf_event>(j));
+        }
+        counters_->read(counters_since_);
+        return;
+    }
+    if (!counters_->available()) {
+        return;
+    }
+
+    perf_counters::values now;
+    counters_->read(now);
+    if (running_ != decode_phase::count) {
+        auto& events = phase_events[static_cast<size_t>(running_)];
+        for (size_t j = 0; j < perf_counters::event_count; ++j) {
+            events[j] += now[j] - counters_since_[j];
+        }
+    }
+    counters_since_ = now;
+}
+
+void decode_stats::switch_allocs(decode_phase phase)
+{
+#ifdef JITANA_ALLOC_SIZE
+    if (running_ == decode_phase::count && phase != decode_phase::count) {
+        // An input starts.
+        live_ = 0;
+        input_peak_ = 0;
+        alloc_stats = this;
+    }
+    else if (running_ != decode_phase::count
+             && phase == decode_phase::count) {
+        // The input ends.
+        alloc_stats = nullptr;
+        peak_live_bytes = std::max(peak_live_bytes, input_peak_);
+    }
+#else
+    (void)phase;
+#endif
+}
+
+void decode_stats::write_allocs_text(std::ostream& os) const
+{
+    if (!alloc_tracking_available()) {
+        os << "  allocation tracking is unavailable\n";
+        return;
+    }
+
+    char buf[120];
+    auto row = [&](const char* name, const alloc_counts& a) {
+        std::snprintf(buf, sizeof(buf), "  %-16s %14llu %14llu %14llu\n",
+                      name, static_cast<unsigned long long>(a.count),
+                      static_cast<unsigned long long>(a.bytes),
+                      static_cast<unsigned long long>(a.peak_live_bytes));
+        os << buf;
+    };
+
+    std::snprintf(buf, sizeof(buf), "  %-16s %14s %14s %14s\n",
+                  "allocations", "count", "bytes", "peak_live");
+    os << buf;
+    alloc_counts total;
+    for (size_t i = 0; i < phase_count; ++i) {
+        const auto& a = phase_allocs[i];
+        row(decode_phase_name(static_cast<decode_phase>(i)), a);
+        total.count += a.count;
+        total.bytes += a.bytes;
+    }
+    total.peak_live_bytes = peak_live_bytes;
+    row("total", total);
+}
+
+void timed_handler::start_document()
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.start_document();
+}
+
+void timed_handler::end_document()
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.end_document();
+}
+
+void timed_handler::start_namespace(boost::string_ref prefix,
+                                    boost::string_ref uri)
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.start_namespace(prefix, uri);
+}
+
+void timed_handler::end_namespace(boost::string_ref prefix,
+                                  boost::string_ref uri)
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.end_namespace(prefix, uri);
+}
+
+void timed_handler::start_element(boost::string_ref name)
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.start_element(name);
+}
+
+void timed_handler::attribute(boost::string_ref name, boost::string_ref value)
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.attribute(name, value);
+}
+
+void timed_handler::end_element(boost::string_ref name)
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.end_element(name);
+}
+
+void timed_handler::cdata(boost::string_ref text)
+{
+    phase_timer timer(&stats_, decode_phase::serialization);
+    handler_.cdata(text);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/inflate.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include <zlib.h>
+
+#ifdef JITANA_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+using namespace jitana;
+
+namespace {
+    /// A raw inflate stream of zlib reset for each use.
+    class zlib_inflater {
+    public:
+        zlib_inflater()
+        {
+            std::memset(&zs_, 0, sizeof(zs_));
+            if (inflateInit2(&zs_, -MAX_WBITS) != Z_OK) {
+                throw inflate_error("failed to initialize zlib");
+            }
+        }
+
+        ~zlib_inflater()
+        {
+            inflateEnd(&zs_);
+        }
+
+        zlib_inflater(const zlib_inflater&) = delete;
+        zlib_inflater& operator=(const zlib_inflater&) = delete;
+
+        void inflate(const uint8_t* in, size_t in_size, uint8_t* out,
+                     size_t out_size)
+        {
+            constexpr size_t max_chunk = std::numeric_limits<uInt>::max();
+
+            inflateReset(&zs_);
+            zs_.next_in = const_cast<Bytef*>(in);
+            zs_.avail_in = 0;
+            zs_.next_out = out;
+            zs_.avail_out = 0;
+
+            // The whole output is available, so it usually finishes in a
+            // single call. Only the data larger than uInt goes in pieces.
+            size_t in_left = in_size;
+            size_t out_left = out_size;
+            for (;;) {
+                if (zs_.avail_in == 0) {
+                    zs_.avail_in = static_cast<uInt>(
+                            std::min(in_left, max_chunk));
+                    in_left -= zs_.avail_in;
+                }
+                if (zs_.avail_out == 0) {
+                    zs_.avail_out = static_cast<uInt>(
+                            std::min(out_left, max_chunk));
+                    out_left -= zs_.avail_out;
+                }
+
+                auto ret = ::inflate(&zs_, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END) {
+                    break;
+                }
+                if (ret != Z_OK) {
+                    throw inflate_error("invalid compressed data");
+                }
+            }
+
+            if (zs_.next_out != out + out_size) {
+                throw inflate_error("invalid uncompressed size");
+            }
+        }
+
+    private:
+        z_stream zs_;
+    };
+
+    void inflate_zlib(const uint8_t* in, size_t in_size, uint8_t* out,
+                      size_t out_size)
+    {
+        thread_local zlib_inflater inflater;
+        inflater.inflate(in, in_size, out, out_size);
+    }
+
+#ifdef JITANA_HAVE_LIBDEFLATE
+    void inflate_libdeflate(const uint8_t* in, size_t in_size, uint8_t* out,
+                            size_t out_size)
+    {
+        struct deleter {
+            void operator()(libdeflate_decompressor* d) const
+            {
+                libdeflate_free_decompressor(d);
+            }
+        };
+        thread_local std::unique_ptr<libdeflate_decompressor, deleter> d(
+                libdeflate_alloc_decompressor());
+        if (!d) {
+            throw inflate_error("failed to initialize libdeflate");
+        }
+
+        // Without the actual size, libdeflate requires the output to be
+        // filled exactly.
+        switch (libdeflate_deflate_decompress(d.get(), in, in_size, out,
+                                              out_size, nullptr)) {
+        case LIBDEFLATE_SUCCESS:
+            break;
+        case LIBDEFLATE_SHORT_OUTPUT:
+        case LIBDEFLATE_INSUFFICIENT_SPACE:
+            throw inflate_error("invalid uncompressed size");
+        default:
+            throw inflate_error("invalid compressed data");
+        }
+    }
+#endif
+}
+
+inflate_backend jitana::inflate_best_backend()
+{
+#ifdef JITANA_HAVE_LIBDEFLATE
+    return inflate_backend::libdeflate;
+#else
+    return inflate_backend::zlib;
+#endif
+}
+
+bool jitana::inflate_backend_available(inflate_backend backend)
+{
+    return backend <= inflate_best_backend();
+}
+
+void jitana::inflate_raw(const void* in, size_t in_size, void* out,
+                         size_t out_size)
+{
+    inflate_raw(in, in_size, out, out_size, inflate_best_backend());
+}
+
+void jitana::inflate_raw(const void* in, size_t in_size, void* out,
+                         size_t out_size, inflate_backend backend)
+{
+    const auto* first = static_cast<const uint8_t*>(in);
+    auto* out_first = static_cast<uint8_t*>(out);
+
+    switch (backend) {
+#ifdef JITANA_HAVE_LIBDEFLATE
+    case inflate_backend::libdeflate:
+        inflate_libdeflate(first, in_size, out_first, out_size);
+        break;
+#endif
+    default:
+        inflate_zlib(first, in_size, out_first, out_size);
+    }
+}
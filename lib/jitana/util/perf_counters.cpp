@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include "jitana/util/perf_counters.hpp"
+
+#ifdef __linux__
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace jitana;
+
+constexpr size_t perf_counters::event_count;
+
+const char* jitana::perf_event_name(perf_event event)
+{
+    static const char* const names[]
+            = {"cycles", "instructions", "branch_misses", "cache_misses"};
+    const auto i = static_cast<size_t>(event);
+    return i < perf_counters::event_count ? names[i] : "none";
+}
+
+#ifdef __linux__
+
+perf_counters::perf_counters()
+{
+    static const uint64_t configs[]
+            = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+               PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+    fds_.fill(-1);
+    slots_.fill(-1);
+    for (size_t i = 0; i < event_count; ++i) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = group_ < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // Count the calling thread on any CPU.
+        const auto fd = static_cast<int>(
+                syscall(SYS_perf_event_open, &attr, 0, -1, group_, 0));
+        if (fd < 0) {
+            continue;
+        }
+        if (group_ < 0) {
+            group_ = fd;
+        }
+        fds_[i] = fd;
+        slots_[i] = static_cast<int>(slot_count_++);
+    }
+
+    if (group_ >= 0) {
+        ioctl(group_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+perf_counters::~perf_counters()
+{
+    for (auto fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void perf_counters::read(values& v) const
+{
+    v.fill(0);
+    if (group_ < 0) {
+        return;
+    }
+
+    // The group is read as the number of the events followed by the counts.
+    uint64_t buf[1 + event_count];
+    const auto n = ::read(group_, buf, sizeof(buf));
+    if (n < static_cast<ssize_t>(sizeof(uint64_t) * (1 + slot_count_))
+        || buf[0] != slot_count_) {
+        return;
+    }
+    for (size_t i = 0; i < event_count; ++i) {
+        if (slots_[i] >= 0) {
+            v[i] = buf[1 + slots_[i]];
+        }
+    }
+}
+
+#else
+
+perf_counters::perf_counters()
+{
+    fds_.fill(-1);
+    slots_.fill(-1);
+}
+
+perf_counters::~perf_counters() = default;
+
+void perf_counters::read(values& v) const
+{
+    v.fill(0);
+}
+
+#endif
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/resource_table.hpp"
+#include "jitana/util/android_attrs.hpp"
+#include "jitana/util/stream_reader.hpp"
+#include "jitana/util/utf16.hpp"
+
+#include <algorithm>
+
+using namespace jitana;
+
+namespace {
+    constexpr uint16_t res_string_pool_type = 0x0001;
+    constexpr uint16_t res_table_type = 0x0002;
+    constexpr uint16_t res_table_package_type = 0x0200;
+    constexpr uint16_t res_table_type_type = 0x0201;
+
+    /// The flags of ResTable_type.
+    constexpr uint8_t type_flag_sparse = 0x01;
+    constexpr uint8_t type_flag_offset16 = 0x02;
+
+    /// The flags of ResTable_entry.
+    constexpr uint16_t entry_flag_complex = 0x0001;
+    constexpr uint16_t entry_flag_compact = 0x0008;
+
+    constexpr uint32_t no_entry = 0xffffffff;
+    constexpr uint16_t no_entry16 = 0xffff;
+
+    /// The offset of ResTable_config in ResTable_type.
+    constexpr size_t type_config_offset = 20;
+
+    /// The size of ResTable_package without typeIdOffset.
+    constexpr size_t package_header_min_size = 284;
+
+    struct res_chunk_header {
+        uint16_t type;
+        uint16_t header_size;
+        uint32_t size;
+    };
+
+    struct res_value {
+        uint16_t size;
+        uint8_t res0;
+        uint8_t data_type;
+        uint32_t data;
+    };
+
+    /// Returns the chunk at the offset after checking that it fits in the
+    /// range.
+    const res_chunk_header& get_chunk(const stream_reader& reader,
+                                      size_t offset)
+    {
+        reader.move_head(offset);
+        const auto& header = reader.peek<res_chunk_header>();
+        if (header.header_size < sizeof(header)
+            || header.header_size > header.size
+            || header.size > reader.size() - offset) {
+            throw resource_table_error("invalid chunk size");
+        }
+        return header;
+    }
+
+    std::string to_utf8(const uint16_t* first, const uint16_t* last)
+    {
+        std::string str(utf16_to_utf8_max_size(last - first), '\0');
+        str.resize(utf16_to_utf8(first, last, &str[0]));
+        return str;
+    }
+}
+
+resource_table::resource_table(const std::string& filename) : file_(filename)
+{
+    first_ = reinterpret_cast<const uint8_t*>(file_.data());
+    last_ = first_ + file_.size();
+    read_table();
+}
+
+resource_table::resource_table(const void* first, const void* last)
+        : first_(static_cast<const uint8_t*>(first)),
+          last_(static_cast<const uint8_t*>(last))
+{
+    read_table();
+}
+
+resource_table::resource_table(std::vector<char> content)
+        : content_(std::move(content))
+{
+    first_ = reinterpret_cast<const uint8_t*>(content_.data());
+    last_ = first_ + content_.size();
+    read_table();
+}
+
+bool resource_table::find_name(uint32_t id, resource_name& name) const
+{
+    entry_ref ref;
+    if (!find_entry(id, ref)) {
+        return false;
+    }
+
+    const auto type_id = (id >> 16) & 0xff;
+    name.package = ref.package->name;
+    name.type = read_string(ref.package->type_strings,
+                            type_id - 1 - ref.package->type_id_offset);
+    name.entry = read_string(ref.package->key_strings, ref.key);
+    return true;
+}
+
+bool resource_table::find_value(uint32_t id, uint8_t& data_type,
+                                uint32_t& data) const
+{
+    entry_ref ref;
+    if (!find_entry(id, ref) || (ref.flags & entry_flag_complex)) {
+        return false;
+    }
+
+    data_type = ref.data_type;
+    data = ref.data;
+    return true;
+}
+
+std::string resource_table::value_string(uint32_t index) const
+{
+    return read_string(value_strings_, index);
+}
+
+bool resource_table::format_reference(uint32_t id, char prefix,
+                                      std::string& out) const
+{
+    // A broken entry is treated as unknown so that the reference is still
+    // printed as a number.
+    resource_name name;
+    bool found = false;
+    try {
+        found = find_name(id, name);
+    }
+    catch (std::runtime_error&) {
+    }
+
+    if (found) {
+        out += prefix;
+        if (name.package != packages_.front().name) {
+            out += name.package;
+            out += ':';
+        }
+        out += name.type;
+        out += '/';
+        out += name.entry;
+        return true;
+    }
+
+    // The framework resources are not in the table of an app, but the
+    // attributes are known.
+    if (const auto* attr_name = android_attr_name(id)) {
+        out += prefix;
+        out += "android:attr/";
+        out += attr_name;
+        return true;
+    }
+
+    return false;
+}
+
+void resource_table::read_table()
+{
+    stream_reader reader(first_, last_);
+    if (reader.size() < sizeof(res_chunk_header)
+        || reader.peek<res_chunk_header>().type != res_table_type) {
+        throw resource_table_error("not a resource table");
+    }
+
+    // Index the global string pool and the packages.
+    const auto& header = get_chunk(reader, 0);
+    reader.set_memory_range(first_, first_ + header.size);
+    for (size_t pos = header.header_size;
+         pos + sizeof(res_chunk_header) <= reader.size();) {
+        const auto& chunk = get_chunk(reader, pos);
+        switch (chunk.type) {
+        case res_string_pool_type:
+            if (value_strings_ == 0) {
+                value_strings_ = static_cast<uint32_t>(pos);
+            }
+            break;
+        case res_table_package_type:
+            read_package(static_cast<uint32_t>(pos), chunk.size);
+            break;
+        }
+        pos += chunk.size;
+    }
+
+    if (packages_.empty()) {
+        throw resource_table_error("no package in resource table");
+    }
+}
+
+void resource_table::read_package(uint32_t offset, uint32_t size)
+{
+    stream_reader reader(first_ + offset, first_ + offset + size);
+    const auto& header = reader.get<res_chunk_header>();
+    if (header.header_size < package_header_min_size) {
+        throw resource_table_error("invalid package header");
+    }
+
+    package_info pkg;
+    pkg.id = reader.get<uint32_t>();
+    const auto* name = &reader.peek<uint16_t>();
+    pkg.name = to_utf8(name, std::find(name, name + 128, 0));
+    reader.move_head_forward(256);
+    pkg.type_strings = offset + reader.get<uint32_t>();
+    /*auto last_public_type =*/reader.get<uint32_t>();
+    pkg.key_strings = offset + reader.get<uint32_t>();
+    /*auto last_public_key =*/reader.get<uint32_t>();
+    pkg.type_id_offset = header.header_size >= package_header_min_size + 4
+            ? reader.get<uint32_t>()
+            : 0;
+
+    // Index the type chunks. Only the offsets are recorded here.
+    for (size_t pos = header.header_size;
+         pos + sizeof(res_chunk_header) <= reader.size();) {
+        const auto& chunk = get_chunk(reader, pos);
+        if (chunk.type == res_table_type_type
+            && chunk.header_size >= type_config_offset + 4) {
+            reader.move_head(pos + sizeof(res_chunk_header));
+            const auto type_id = reader.get<uint8_t>();
+            if (type_id != 0) {
+                if (pkg.types.size() < type_id) {
+                    pkg.types.resize(type_id);
+                }
+                auto& chunks = pkg.types[type_id - 1];
+
+                // The configuration is the default one if all the fields
+                // after the size are zero.
+                const auto* config = reinterpret_cast<const uint8_t*>(&chunk)
+                        + type_config_offset;
+                const auto* config_last = reinterpret_cast<const uint8_t*>(
+                                                  &chunk)
+                        + chunk.header_size;
+                reader.move_head(pos + type_config_offset);
+                const auto config_size = reader.get<uint32_t>();
+                config_last = std::min(config_last, config + config_size);
+                const bool is_default = std::all_of(
+                        config + 4, config_last, [](uint8_t b) {
+                            return b == 0;
+                        });
+
+                const auto chunk_offset = offset + static_cast<uint32_t>(pos);
+                if (is_default) {
+                    chunks.insert(chunks.begin(), chunk_offset);
+                }
+                else {
+                    chunks.push_back(chunk_offset);
+                }
+            }
+        }
+        pos += chunk.size;
+    }
+
+    packages_.push_back(std::move(pkg));
+}
+
+const resource_table::package_info*
+resource_table::find_package(uint32_t id) const
+{
+    for (const auto& pkg : packages_) {
+        if (pkg.id == id) {
+            return &pkg;
+        }
+    }
+    return nullptr;
+}
+
+bool resource_table::find_entry(uint32_t id, entry_ref& ref) const
+{
+    const auto* pkg = find_package(id >> 24);
+    const auto type_id = (id >> 16) & 0xff;
+    if (pkg == nullptr || type_id == 0 || type_id > pkg->types.size()) {
+        return false;
+    }
+
+    // Look for the configuration that has the entry.
+    for (auto chunk : pkg->types[type_id - 1]) {
+        if (read_entry(chunk, id & 0xffff, ref)) {
+            ref.package = pkg;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool resource_table::read_entry(uint32_t chunk, uint32_t index,
+                                entry_ref& ref) const
+{
+    // The size of the chunk is checked when it is indexed.
+    stream_reader reader(first_ + chunk, last_);
+    const auto& header = reader.get<res_chunk_header>();
+    reader.set_memory_range(first_ + chunk, first_ + chunk + header.size);
+    reader.move_head(sizeof(res_chunk_header) + 1);
+    const auto flags = reader.get<uint8_t>();
+    reader.get<uint16_t>();
+    const auto entry_count = reader.get<uint32_t>();
+    const auto entries_start = reader.get<uint32_t>();
+
+    // Find the offset of the entry.
+    uint32_t offset;
+    if (flags & type_flag_sparse) {
+        // The pairs of the index and the offset / 4 are sorted by the index.
+        size_t lo = 0;
+        size_t hi = entry_count;
+        for (;;) {
+            if (lo >= hi) {
+                return false;
+            }
+            const auto mid = lo + (hi - lo) / 2;
+            reader.move_head(header.header_size + 4 * mid);
+            const auto mid_index = reader.get<uint16_t>();
+            if (mid_index == index) {
+                offset = reader.get<uint16_t>() * 4u;
+                break;
+            }
+            if (mid_index < index) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+    }
+    else if (index >= entry_count) {
+        return false;
+    }
+    else if (flags & type_flag_offset16) {
+        reader.move_head(header.header_size + 2 * index);
+        const auto off16 = reader.get<uint16_t>();
+        if (off16 == no_entry16) {
+            return false;
+        }
+        offset = off16 * 4u;
+    }
+    else {
+        reader.move_head(header.header_size + 4 * index);
+        offset = reader.get<uint32_t>();
+        if (offset == no_entry) {
+            return false;
+        }
+    }
+
+    // Read the entry. A compact entry has the key and the value in itself.
+    reader.move_head(static_cast<size_t>(entries_start) + offset);
+    const auto entry_size = reader.get<uint16_t>();
+    ref.flags = reader.get<uint16_t>();
+    if (ref.flags & entry_flag_compact) {
+        ref.flags &= ~entry_flag_complex;
+        ref.key = entry_size;
+        ref.data_type = static_cast<uint8_t>(ref.flags >> 8);
+        ref.data = reader.get<uint32_t>();
+    }
+    else {
+        ref.key = reader.get<uint32_t>();
+        ref.data_type = 0;
+        ref.data = 0;
+        if (!(ref.flags & entry_flag_complex)) {
+            reader.move_head(static_cast<size_t>(entries_start) + offset
+                             + entry_size);
+            const auto& value = reader.get<res_value>();
+            ref.data_type = value.data_type;
+            ref.data = value.data;
+        }
+    }
+    return true;
+}
+
+std::string resource_table::read_string(uint32_t pool, uint32_t index) const
+{
+    if (pool == 0) {
+        throw resource_table_error("no string pool");
+    }
+    stream_reader reader(first_, last_);
+    const auto& header = get_chunk(reader, pool);
+    if (header.type != res_string_pool_type) {
+        throw resource_table_error("invalid string pool");
+    }
+    reader.set_memory_range(first_ + pool, first_ + pool + header.size);
+    reader.move_head(sizeof(res_chunk_header));
+    const auto string_count = reader.get<uint32_t>();
+    /*auto style_count =*/reader.get<uint32_t>();
+    const bool utf8 = reader.get<uint32_t>() & (1 << 8);
+    const auto strings_start = reader.get<uint32_t>();
+    if (index >= string_count) {
+        throw resource_table_error("invalid string index");
+    }
+
+    reader.move_head(header.header_size + 4 * static_cast<size_t>(index));
+    reader.move_head(static_cast<size_t>(strings_start)
+                     + reader.get<uint32_t>());
+    if (utf8) {
+        // Skip the length in UTF-16 and read the length in bytes.
+        if (reader.get<uint8_t>() & 0x80) {
+            reader.get<uint8_t>();
+        }
+        size_t len = reader.get<uint8_t>();
+        if (len & 0x80) {
+            len = ((len & 0x7f) << 8) | reader.get<uint8_t>();
+        }
+        if (len > reader.size() - reader.head()) {
+            throw resource_table_error("invalid string length");
+        }
+        const auto* first = static_cast<const char*>(reader.begin())
+                + reader.head();
+        return std::string(first, len);
+    }
+    else {
+        size_t len = reader.get<uint16_t>();
+        if (len & 0x8000) {
+            len = ((len & 0x7fff) << 16) | reader.get<uint16_t>();
+        }
+        if (len > (reader.size() - reader.head()) / 2) {
+            throw resource_table_error("invalid string length");
+        }
+        const auto* first = reinterpret_cast<const uint16_t*>(
+                static_cast<const uint8_t*>(reader.begin()) + reader.head());
+        return to_utf8(first, first + len);
+    }
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/thread_pool.hpp"
+
+#include <algorithm>
+
+using namespace jitana;
+
+namespace {
+    /// The pool and the index of the worker running on this thread.
+    thread_local const void* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+}
+
+thread_pool::thread_pool(size_t size)
+{
+    if (size == 0) {
+        size = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    queues_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        queues_.emplace_back(new worker_queue);
+    }
+    workers_.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        workers_.emplace_back(&thread_pool::run, this, i);
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        tasks_done_.wait(lock, [&] { return pending_ == 0; });
+        stopping_ = true;
+    }
+    task_posted_.notify_all();
+
+    for (auto& w : workers_) {
+        w.join();
+    }
+}
+
+void thread_pool::post(task t)
+{
+    // Keep the tasks posted by a worker in its own queue.
+    const auto q = current_pool == this
+            ? current_worker
+            : next_queue_.fetch_add(1) % queues_.size();
+
+    // Count the task first so that it is never finished before counted.
+    ++pending_;
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        queues_[q]->tasks.push_back(std::move(t));
+    }
+    ++queued_;
+
+    // A worker about to sleep has counted itself before checking queued_,
+    // so either it sees the task or it is seen here. Taking the lock makes
+    // sure it is waiting before being notified.
+    if (sleepers_ > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+        }
+        task_posted_.notify_one();
+    }
+}
+
+void thread_pool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    tasks_done_.wait(lock, [&] { return pending_ == 0; });
+
+    if (error_) {
+        auto e = error_;
+        error_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+bool thread_pool::claim()
+{
+    auto n = queued_.load();
+    while (n > 0 && !queued_.compare_exchange_weak(n, n - 1)) {
+    }
+    return n > 0;
+}
+
+bool thread_pool::claim_soon()
+{
+    // Sleeping and being woken up cost more than yielding a few times when
+    // the tasks are posted one after another.
+    for (int i = 0; i < 16; ++i) {
+        if (claim()) {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+bool thread_pool::pop(size_t worker, task& t)
+{
+    // Take the oldest task of its own queue first.
+    {
+        auto& q = *queues_[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // Steal the newest task of another queue.
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        auto& q = *queues_[(worker + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void thread_pool::run(size_t worker)
+{
+    current_pool = this;
+    current_worker = worker;
+
+    for (;;) {
+        if (!claim_soon()) {
+            // Sleep until a task is posted.
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++sleepers_;
+            task_posted_.wait(lock, [&] { return stopping_ || queued_ > 0; });
+            --sleepers_;
+            if (stopping_ && queued_ == 0) {
+                return;
+            }
+            continue;
+        }
+
+        // The tasks in the queues are never fewer than the ones claimed, so
+        // one is found, though it may take another look if the others take
+        // tasks from the queues at the same time.
+        task t;
+        while (!pop(worker, t)) {
+            std::this_thread::yield();
+        }
+
+        std::exception_ptr error;
+        try {
+            t(worker);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        t = nullptr;
+
+        if (error) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = error;
+            }
+        }
+        if (--pending_ == 0) {
+            // Make sure the threads waiting have checked pending_.
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            tasks_done_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/utf16.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JITANA_UTF16_SSE2 1
+#define JITANA_UTF16_AVX2 1
+#define JITANA_TARGET(x) __attribute__((target(x)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define JITANA_UTF16_SSE2 1
+#define JITANA_TARGET(x)
+#include <emmintrin.h>
+#endif
+
+using namespace jitana;
+
+namespace {
+    /// Converts a code point starting at first. Invalid surrogates are
+    /// skipped in the same way as boost::locale::conv::utf_to_utf().
+    inline void convert_one(const uint16_t*& first, const uint16_t* last,
+                            char*& out)
+    {
+        uint32_t c = *first++;
+
+        if (c < 0x80) {
+            *out++ = static_cast<char>(c);
+            return;
+        }
+
+        if (c < 0x800) {
+            *out++ = static_cast<char>(0xc0 | (c >> 6));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+            return;
+        }
+
+        if (c < 0xd800 || 0xdfff < c) {
+            *out++ = static_cast<char>(0xe0 | (c >> 12));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+            return;
+        }
+
+        // Combine the surrogate pair.
+        if (c > 0xdbff || first == last) {
+            return;
+        }
+        uint32_t c2 = *first++;
+        if (c2 < 0xdc00 || 0xdfff < c2) {
+            return;
+        }
+        c = 0x10000 + ((c - 0xd800) << 10) + (c2 - 0xdc00);
+
+        *out++ = static_cast<char>(0xf0 | (c >> 18));
+        *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+        *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        *out++ = static_cast<char>(0x80 | (c & 0x3f));
+    }
+
+    size_t convert_scalar(const uint16_t* first, const uint16_t* last,
+                          char* out)
+    {
+        auto* out_first = out;
+        while (first != last) {
+            convert_one(first, last, out);
+        }
+        return out - out_first;
+    }
+
+#ifdef JITANA_UTF16_SSE2
+    /// Copies 8 code units at a time while they are all ASCII.
+    JITANA_TARGET("sse2")
+    size_t convert_sse2(const uint16_t* first, const uint16_t* last,
+                        char* out)
+    {
+        auto* out_first = out;
+        const __m128i non_ascii_mask = _mm_set1_epi16(-0x80);
+        const __m128i zero = _mm_setzero_si128();
+
+        while (last - first >= 8) {
+            __m128i v
+                    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            __m128i non_ascii = _mm_and_si128(v, non_ascii_mask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) == 0xffff) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+                                 _mm_packus_epi16(v, v));
+                first += 8;
+                out += 8;
+            }
+            else {
+                const auto* block_last = first + 8;
+                while (first < block_last) {
+                    convert_one(first, last, out);
+                }
+            }
+        }
+
+        while (first != last) {
+            convert_one(first, last, out);
+        }
+        return out - out_first;
+    }
+#endif
+
+#if defined(JITANA_UTF16_AVX2) && defined(JITANA_UTF16_SSE2)
+    /// Copies 16 code units at a time while they are all ASCII.
+    JITANA_TARGET("avx2")
+    size_t convert_avx2(const uint16_t* first, const uint16_t* last,
+                        char* out)
+    {
+        auto* out_first = out;
+        const __m256i non_ascii_mask = _mm256_set1_epi16(-0x80);
+
+        while (last - first >= 16) {
+            __m256i v = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(first));
+            if (_mm256_testz_si256(v, non_ascii_mask)) {
+                __m128i packed
+                        = _mm_packus_epi16(_mm256_castsi256_si128(v),
+                                           _mm256_extracti128_si256(v, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+                first += 16;
+                out += 16;
+            }
+            else {
+                const auto* block_last = first + 16;
+                while (first < block_last) {
+                    convert_one(first, last, out);
+                }
+            }
+        }
+
+        // Let the SSE2 version handle the rest. Clear the upper halves of the
+        // registers first to avoid the AVX-SSE transition penalty.
+        _mm256_zeroupper();
+        return (out - out_first) + convert_sse2(first, last, out);
+    }
+#endif
+
+    utf16_isa detect_isa()
+    {
+#if defined(JITANA_UTF16_AVX2) && defined(JITANA_UTF16_SSE2)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return utf16_isa::avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return utf16_isa::sse2;
+        }
+        return utf16_isa::scalar;
+#elif defined(JITANA_UTF16_SSE2)
+        return utf16_isa::sse2;
+#else
+        return utf16_isa::scalar;
+#endif
+    }
+}
+
+utf16_isa jitana::utf16_best_isa()
+{
+    static const utf16_isa isa = detect_isa();
+    return isa;
+}
+
+size_t jitana::utf16_to_utf8(const uint16_t* first, const uint16_t* last,
+                             char* out)
+{
+    return utf16_to_utf8(first, last, out, utf16_best_isa());
+}
+
+size_t jitana::utf16_to_utf8(const uint16_t* first, const uint16_t* last,
+                             char* out, utf16_isa isa)
+{
+    if (isa > utf16_best_isa()) {
+        isa = utf16_best_isa();
+    }
+
+    switch (isa) {
+#if defined(JITANA_UTF16_AVX2) && defined(JITANA_UTF16_SSE2)
+    case utf16_isa::avx2:
+        return convert_avx2(first, last, out);
+#endif
+#ifdef JITANA_UTF16_SSE2
+    case utf16_isa::sse2:
+        return convert_sse2(first, last, out);
+#endif
+    default:
+        return convert_scalar(first, last, out);
+    }
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/xml_writer.hpp"
+
+using namespace jitana;
+
+namespace {
+    constexpr size_t flush_threshold = 1 << 16;
+}
+
+xml_writer::xml_writer(std::ostream& os, char indent_char, int indent_count)
+        : os_(os), indent_char_(indent_char), indent_count_(indent_count)
+{
+}
+
+void xml_writer::start_document()
+{
+    buffer_ += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+
+    // The bottom of the stack represents the document itself.
+    stack_.clear();
+    names_.clear();
+    namespaces_.clear();
+    pending_text_.clear();
+    pending_text_ends_.clear();
+    stack_.push_back({0, 0, false});
+}
+
+void xml_writer::end_document()
+{
+    // The character data at the top level is written without line breaks
+    // unless there is an element.
+    if (!stack_.empty() && !stack_.back().has_elements) {
+        size_t first = 0;
+        for (auto last : pending_text_ends_) {
+            write_encoded(boost::string_ref(pending_text_.data() + first,
+                                            last - first));
+            first = last;
+        }
+    }
+    pending_text_.clear();
+    pending_text_ends_.clear();
+
+    flush();
+}
+
+void xml_writer::start_namespace(boost::string_ref prefix,
+                                 boost::string_ref uri)
+{
+    namespaces_.emplace_back(prefix.to_string(), uri.to_string());
+}
+
+void xml_writer::end_namespace(boost::string_ref /*prefix*/,
+                               boost::string_ref /*uri*/)
+{
+    // Ignore the ones not declared in the current element, which only a
+    // malformed document has.
+    const auto offset = stack_.empty() ? 0 : stack_.back().namespace_offset;
+    if (namespaces_.size() > offset) {
+        namespaces_.pop_back();
+    }
+}
+
+void xml_writer::start_element(boost::string_ref name)
+{
+    // Without start_document(), the element is at the top level.
+    if (stack_.empty()) {
+        stack_.push_back({0, 0, false});
+    }
+    const int depth = static_cast<int>(stack_.size()) - 1;
+
+    // Now the parent is known to have an element. Close its start tag and
+    // write the character data held so far on separate lines.
+    auto& parent = stack_.back();
+    if (!parent.has_elements) {
+        if (depth > 0) {
+            buffer_ += '>';
+            write_newline();
+        }
+
+        size_t first = 0;
+        for (auto last : pending_text_ends_) {
+            write_indent(depth);
+            write_encoded(boost::string_ref(pending_text_.data() + first,
+                                            last - first));
+            write_newline();
+            first = last;
+        }
+        pending_text_.clear();
+        pending_text_ends_.clear();
+
+        parent.has_elements = true;
+    }
+
+    // Write the start tag. It is closed when the first child or the end of
+    // the element is found.
+    write_indent(depth);
+    buffer_ += '<';
+    buffer_.append(name.data(), name.size());
+
+    // The namespaces declared in the parent are written as attributes.
+    for (size_t i = parent.namespace_offset; i < namespaces_.size(); ++i) {
+        attribute("xmlns:" + namespaces_[i].first, namespaces_[i].second);
+    }
+
+    stack_.push_back({names_.size(), namespaces_.size(), false});
+    names_.append(name.data(), name.size());
+}
+
+void xml_writer::attribute(boost::string_ref name, boost::string_ref value)
+{
+    buffer_ += ' ';
+    buffer_.append(name.data(), name.size());
+    buffer_ += "=\"";
+    write_encoded(value);
+    buffer_ += '"';
+}
+
+void xml_writer::end_element(boost::string_ref /*name*/)
+{
+    // Ignore the ones not matching any element, which only a malformed
+    // document has. The bottom of the stack is the document.
+    if (stack_.size() < 2) {
+        return;
+    }
+    const auto elem = stack_.back();
+    const int depth = static_cast<int>(stack_.size()) - 2;
+    const auto* name = names_.data() + elem.name_offset;
+    const auto name_size = names_.size() - elem.name_offset;
+
+    if (elem.has_elements) {
+        write_indent(depth);
+        buffer_ += "</";
+        buffer_.append(name, name_size);
+        buffer_ += '>';
+    }
+    else if (!pending_text_ends_.empty()) {
+        // Write the character data inline.
+        buffer_ += '>';
+        size_t first = 0;
+        for (auto last : pending_text_ends_) {
+            write_encoded(boost::string_ref(pending_text_.data() + first,
+                                            last - first));
+            first = last;
+        }
+        pending_text_.clear();
+        pending_text_ends_.clear();
+
+        buffer_ += "</";
+        buffer_.append(name, name_size);
+        buffer_ += '>';
+    }
+    else {
+        buffer_ += "/>";
+    }
+    write_newline();
+
+    names_.resize(elem.name_offset);
+    namespaces_.resize(elem.namespace_offset);
+    stack_.pop_back();
+
+    flush_if_full();
+}
+
+void xml_writer::cdata(boost::string_ref text)
+{
+    if (!stack_.empty() && stack_.back().has_elements) {
+        const int depth = static_cast<int>(stack_.size()) - 1;
+        write_indent(depth);
+        write_encoded(text);
+        write_newline();
+        flush_if_full();
+    }
+    else {
+        // Hold the text until we know how it should be laid out.
+        pending_text_.append(text.data(), text.size());
+        pending_text_ends_.push_back(pending_text_.size());
+    }
+}
+
+void xml_writer::flush()
+{
+    os_.write(buffer_.data(), buffer_.size());
+    flushed_size_ += buffer_.size();
+    buffer_.clear();
+}
+
+void xml_writer::write_indent(int indent)
+{
+    if (indent > 0) {
+        buffer_.append(indent * indent_count_, indent_char_);
+    }
+}
+
+void xml_writer::write_encoded(boost::string_ref s)
+{
+    if (s.empty()) {
+        return;
+    }
+
+    // Encode the first space if the text contains only spaces so that it
+    // survives the round trip.
+    if (s.find_first_not_of(' ') == boost::string_ref::npos) {
+        buffer_ += "&#32;";
+        buffer_.append(s.size() - 1, ' ');
+        return;
+    }
+
+    for (auto c : s) {
+        switch (c) {
+        case '<':
+            buffer_ += "&lt;";
+            break;
+        case '>':
+            buffer_ += "&gt;";
+            break;
+        case '&':
+            buffer_ += "&amp;";
+            break;
+        case '"':
+            buffer_ += "&quot;";
+            break;
+        case '\'':
+            buffer_ += "&apos;";
+            break;
+        default:
+            buffer_ += c;
+        }
+    }
+}
+
+void xml_writer::write_newline()
+{
+    if (indent_count_ > 0) {
+        buffer_ += '\n';
+    }
+}
+
+void xml_writer::flush_if_full()
+{
+    if (buffer_.size() >= flush_threshold) {
+        flush();
+    }
+}
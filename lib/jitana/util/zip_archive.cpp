@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2016, 2017, Yutaka Tsutano
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "jitana/util/zip_archive.hpp"
+#include "jitana/util/crc32.hpp"
+#include "jitana/util/inflate.hpp"
+#include "jitana/util/stream_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include <zlib.h>
+
+using namespace jitana;
+
+namespace {
+    constexpr uint32_t local_header_signature = 0x04034b50;
+    constexpr uint32_t central_header_signature = 0x02014b50;
+    constexpr uint32_t eocd_signature = 0x06054b50;
+    constexpr uint32_t zip64_eocd_signature = 0x06064b50;
+    constexpr uint32_t zip64_eocd_locator_signature = 0x07064b50;
+    constexpr uint16_t zip64_extra_id = 0x0001;
+
+    constexpr size_t local_header_size = 30;
+    constexpr size_t central_header_size = 46;
+    constexpr size_t eocd_size = 22;
+    constexpr size_t zip64_eocd_locator_size = 20;
+    constexpr size_t max_comment_size = 0xffff;
+
+    /// The maximum compression ratio of deflate.
+    constexpr uint64_t max_deflate_ratio = 1032;
+
+    /// The largest chunk zlib can take at once.
+    constexpr uint64_t max_zlib_chunk = std::numeric_limits<uInt>::max();
+
+    uint32_t read_u32(const char* p)
+    {
+        uint32_t x;
+        std::memcpy(&x, p, sizeof(x));
+        return x;
+    }
+
+    /// Computes the FNV-1a hash of the name.
+    uint32_t hash_name(boost::string_ref name)
+    {
+        uint32_t h = 2166136261u;
+        for (auto c : name) {
+            h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return h;
+    }
+}
+
+constexpr uint16_t zip_archive::method_stored;
+constexpr uint16_t zip_archive::method_deflated;
+constexpr uint16_t zip_archive::flag_encrypted;
+
+zip_archive::zip_archive(const std::string& filename) : file_(filename)
+{
+    first_ = file_.data();
+    last_ = file_.data() + file_.size();
+    read_central_directory();
+    build_index();
+}
+
+zip_archive::zip_archive(const void* first, const void* last)
+        : first_(static_cast<const char*>(first)),
+          last_(static_cast<const char*>(last))
+{
+    read_central_directory();
+    build_index();
+}
+
+const zip_archive::entry* zip_archive::find(boost::string_ref name) const
+{
+    if (index_.empty()) {
+        return nullptr;
+    }
+
+    const auto mask = index_.size() - 1;
+    for (auto h = hash_name(name) & mask; index_[h] != 0; h = (h + 1) & mask) {
+        const auto& e = entries_[index_[h] - 1];
+        if (e.name == name) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+boost::string_ref zip_archive::raw_data(const entry& e) const
+{
+    const uint64_t size = last_ - first_;
+    if (e.local_header_offset > size
+        || size - e.local_header_offset < local_header_size) {
+        throw zip_archive_error("invalid local header offset");
+    }
+
+    stream_reader reader(first_ + e.local_header_offset, last_);
+    if (reader.get<uint32_t>() != local_header_signature) {
+        throw zip_archive_error("invalid local header");
+    }
+    reader.move_head(26);
+    auto name_size = reader.get<uint16_t>();
+    auto extra_size = reader.get<uint16_t>();
+
+    // The sizes in the central directory are used since the local header
+    // may leave them to the data descriptor.
+    const uint64_t data_offset = e.local_header_offset + local_header_size
+            + name_size + extra_size;
+    if (data_offset > size || size - data_offset < e.compressed_size) {
+        throw zip_archive_error("invalid entry size");
+    }
+    return boost::string_ref(first_ + data_offset, e.compressed_size);
+}
+
+std::vector<char> zip_archive::extract(const entry& e) const
+{
+    std::vector<char> content;
+    extract(e, content);
+    return content;
+}
+
+void zip_archive::extract(const entry& e, std::vector<char>& content) const
+{
+    auto data = checked_data(e);
+    switch (e.method) {
+    case method_stored:
+        if (e.uncompressed_size != e.compressed_size) {
+            throw zip_archive_error("invalid entry size");
+        }
+        content.assign(data.begin(), data.end());
+        break;
+    case method_deflated:
+        // Reject the sizes that cannot come from deflate before allocating.
+        if (e.uncompressed_size / max_deflate_ratio > e.compressed_size) {
+            throw zip_archive_error("invalid uncompressed size");
+        }
+        // The size is known, so inflate it in one go.
+        content.resize(e.uncompressed_size);
+        try {
+            inflate_raw(data.data(), data.size(), content.data(),
+                        content.size());
+        }
+        catch (const inflate_error& ex) {
+            throw zip_archive_error(ex.what());
+        }
+        break;
+    default:
+        throw zip_archive_error("unsupported compression method");
+    }
+
+    if (crc32_update(0, content.data(), content.size()) != e.crc32) {
+        throw zip_archive_error("CRC-32 mismatch");
+    }
+}
+
+void zip_archive::extract(
+        const entry& e, const std::function<void(const char*, size_t)>& f) const
+{
+    auto data = checked_data(e);
+    uint32_t crc = 0;
+    switch (e.method) {
+    case method_stored:
+        if (e.uncompressed_size != e.compressed_size) {
+            throw zip_archive_error("invalid entry size");
+        }
+        // Verify the content first since it is available at once.
+        crc = crc32_update(0, data.data(), data.size());
+        if (crc != e.crc32) {
+            throw zip_archive_error("CRC-32 mismatch");
+        }
+        f(data.data(), data.size());
+        break;
+    case method_deflated: {
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+            throw zip_archive_error("failed to initialize zlib");
+        }
+        std::unique_ptr<z_stream, int (*)(z_stream*)> guard(&zs, inflateEnd);
+
+        // Inflate into a small buffer and pass it on whenever it is filled.
+        std::vector<char> buffer(1 << 16);
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        uint64_t in_left = data.size();
+        uint64_t produced = 0;
+        for (int ret = Z_OK; ret != Z_STREAM_END;) {
+            if (zs.avail_in == 0) {
+                zs.avail_in = static_cast<uInt>(
+                        std::min(in_left, max_zlib_chunk));
+                in_left -= zs.avail_in;
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+            zs.avail_out = static_cast<uInt>(buffer.size());
+
+            ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                throw zip_archive_error("invalid compressed data");
+            }
+
+            auto n = buffer.size() - zs.avail_out;
+            produced += n;
+            if (produced > e.uncompressed_size) {
+                throw zip_archive_error("invalid uncompressed size");
+            }
+            crc = crc32_update(crc, buffer.data(), n);
+            f(buffer.data(), n);
+        }
+        if (produced != e.uncompressed_size) {
+            throw zip_archive_error("invalid uncompressed size");
+        }
+        break;
+    }
+    default:
+        throw zip_archive_error("unsupported compression method");
+    }
+
+    if (crc != e.crc32) {
+        throw zip_archive_error("CRC-32 mismatch");
+    }
+}
+
+boost::string_ref zip_archive::checked_data(const entry& e) const
+{
+    if (e.flags & flag_encrypted) {
+        throw zip_archive_error("encrypted entries are not supported");
+    }
+    return raw_data(e);
+}
+
+void zip_archive::read_central_directory()
+{
+    const size_t size = last_ - first_;
+    if (size < eocd_size) {
+        throw zip_archive_error("not a ZIP file");
+    }
+
+    // Find the end of central directory record backward. It is followed by
+    // a comment of up to 64 KiB, which may contain the signature as well, so
+    // prefer the one whose comment ends at the end of the file.
+    const size_t min_pos
+            = size > eocd_size + max_comment_size
+            ? size - eocd_size - max_comment_size
+            : 0;
+    const size_t not_found = static_cast<size_t>(-1);
+    size_t eocd_pos = not_found;
+    for (size_t pos = size - eocd_size + 1; pos-- > min_pos;) {
+        if (read_u32(first_ + pos) != eocd_signature) {
+            continue;
+        }
+        if (eocd_pos == not_found) {
+            eocd_pos = pos;
+        }
+
+        uint16_t comment_size;
+        std::memcpy(&comment_size, first_ + pos + 20, sizeof(comment_size));
+        if (pos + eocd_size + comment_size == size) {
+            eocd_pos = pos;
+            break;
+        }
+    }
+    if (eocd_pos == not_found) {
+        throw zip_archive_error("not a ZIP file");
+    }
+
+    stream_reader reader(first_, last_);
+    reader.move_head(eocd_pos + 10);
+    uint64_t entry_count = reader.get<uint16_t>();
+    uint64_t cd_size = reader.get<uint32_t>();
+    uint64_t cd_offset = reader.get<uint32_t>();
+
+    // Read the ZIP64 end of central directory record if any of the values
+    // does not fit.
+    if ((entry_count == 0xffff || cd_size == 0xffffffff
+         || cd_offset == 0xffffffff)
+        && eocd_pos >= zip64_eocd_locator_size
+        && read_u32(first_ + eocd_pos - zip64_eocd_locator_size)
+                == zip64_eocd_locator_signature) {
+        reader.move_head(eocd_pos - zip64_eocd_locator_size + 8);
+        auto zip64_eocd_offset = reader.get<uint64_t>();
+        if (zip64_eocd_offset > eocd_pos) {
+            throw zip_archive_error("invalid ZIP64 end of central directory");
+        }
+
+        reader.move_head(zip64_eocd_offset);
+        if (reader.get<uint32_t>() != zip64_eocd_signature) {
+            throw zip_archive_error("invalid ZIP64 end of central directory");
+        }
+        reader.move_head(zip64_eocd_offset + 32);
+        entry_count = reader.get<uint64_t>();
+        cd_size = reader.get<uint64_t>();
+        cd_offset = reader.get<uint64_t>();
+    }
+
+    if (cd_offset > size || size - cd_offset < cd_size) {
+        throw zip_archive_error("invalid central directory");
+    }
+
+    entries_.clear();
+    entries_.reserve(std::min(entry_count, cd_size / central_header_size));
+
+    reader.set_memory_range(first_ + cd_offset, first_ + cd_offset + cd_size);
+    for (uint64_t i = 0; i < entry_count; ++i) {
+        if (reader.get<uint32_t>() != central_header_signature) {
+            throw zip_archive_error("invalid central directory");
+        }
+
+        entry e;
+        /*auto version_made_by =*/reader.get<uint16_t>();
+        /*auto version_needed =*/reader.get<uint16_t>();
+        e.flags = reader.get<uint16_t>();
+        e.method = reader.get<uint16_t>();
+        /*auto mod_time =*/reader.get<uint16_t>();
+        /*auto mod_date =*/reader.get<uint16_t>();
+        e.crc32 = reader.get<uint32_t>();
+        e.compressed_size = reader.get<uint32_t>();
+        e.uncompressed_size = reader.get<uint32_t>();
+        auto name_size = reader.get<uint16_t>();
+        auto extra_size = reader.get<uint16_t>();
+        auto comment_size = reader.get<uint16_t>();
+        /*auto disk_start =*/reader.get<uint16_t>();
+        /*auto internal_attrs =*/reader.get<uint16_t>();
+        /*auto external_attrs =*/reader.get<uint32_t>();
+        e.local_header_offset = reader.get<uint32_t>();
+
+        const char* name = static_cast<const char*>(reader.begin())
+                + reader.head();
+        reader.move_head_forward(name_size);
+        e.name = boost::string_ref(name, name_size);
+
+        // The values that do not fit are in the ZIP64 extra field in this
+        // order.
+        const char* extra = name + name_size;
+        reader.move_head_forward(extra_size);
+        stream_reader extra_reader(extra, extra + extra_size);
+        while (extra_reader.head() + 4 <= extra_reader.size()) {
+            auto id = extra_reader.get<uint16_t>();
+            auto data_size = extra_reader.get<uint16_t>();
+            if (id != zip64_extra_id) {
+                extra_reader.move_head_forward(data_size);
+                continue;
+            }
+
+            if (e.uncompressed_size == 0xffffffff) {
+                e.uncompressed_size = extra_reader.get<uint64_t>();
+            }
+            if (e.compressed_size == 0xffffffff) {
+                e.compressed_size = extra_reader.get<uint64_t>();
+            }
+            if (e.local_header_offset == 0xffffffff) {
+                e.local_header_offset = extra_reader.get<uint64_t>();
+            }
+            break;
+        }
+
+        reader.move_head_forward(comment_size);
+        entries_.push_back(e);
+    }
+}
+
+void zip_archive::build_index()
+{
+    if (entries_.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw zip_archive_error("too many entries");
+    }
+
+    // Keep the load factor at most 50%.
+    size_t capacity = 16;
+    while (capacity < entries_.size() * 2) {
+        capacity *= 2;
+    }
+    index_.assign(capacity, 0);
+
+    const auto mask = capacity - 1;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        auto h = hash_name(entries_[i].name) & mask;
+        for (; index_[h] != 0; h = (h + 1) & mask) {
+            // Keep the first one if the name appears more than once.
+            if (entries_[index_[h] - 1].name == entries_[i].name) {
+                break;
+            }
+        }
+        if (index_[h] == 0) {
+            index_[h] = static_cast<uint32_t>(i + 1);
+        }
+    }
+}
@@ -15,127 +15,1427 @@
  */
 
 #include "axmldec_config.hpp"
+#include "jitana/util/axml_encoder.hpp"
 #include "jitana/util/axml_parser.hpp"
+#include "jitana/util/concurrent_memo.hpp"
+#include "jitana/util/decode_cache.hpp"
+#include "jitana/util/decode_stats.hpp"
+#include "jitana/util/resource_table.hpp"
+#include "jitana/util/thread_pool.hpp"
+#include "jitana/util/xml_writer.hpp"
+#include "jitana/util/xxhash64.hpp"
+#include "jitana/util/zip_archive.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <future>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 #include <vector>
 #include <string>
 
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/program_options.hpp>
 
-#include <unzip.h>
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+#include <boost/asio/local/stream_protocol.hpp>
+#include <sys/socket.h>
+#endif
 
 namespace boost_pt = boost::property_tree;
 
-struct membuf : std::streambuf {
-    membuf(const char* base, size_t size)
+/// The largest manifest inflated at once instead of in pieces. The one-shot
+/// inflation is faster, but needs the whole content in memory.
+constexpr uint64_t max_one_shot_size = 4 << 20;
+
+void write_xml(std::ostream& os, const boost_pt::ptree& pt)
+{
+#if BOOST_MAJOR_VERSION == 1 && BOOST_MINOR_VERSION < 56
+    boost_pt::xml_writer_settings<char> settings(' ', 2);
+#else
+    boost_pt::xml_writer_settings<std::string> settings(' ', 2);
+#endif
+    boost_pt::write_xml(os, pt, settings);
+}
+
+void write_xml(const std::string& output_filename, const boost_pt::ptree& pt,
+               jitana::decode_stats* stats)
+{
+    jitana::phase_timer timer(stats, jitana::decode_phase::serialization);
+
+    // Construct the output stream.
+    std::ostream* os = &std::cout;
+    std::ofstream ofs;
+    if (!output_filename.empty()) {
+        ofs.open(output_filename);
+        os = &ofs;
+    }
+
+    // Write the ptree to the output. It is formatted in the memory first to
+    // count the bytes if needed.
+    if (stats) {
+        std::ostringstream oss;
+        write_xml(oss, pt);
+        const auto xml = oss.str();
+        os->write(xml.data(), xml.size());
+        stats->bytes_out += xml.size();
+    }
+    else {
+        write_xml(*os, pt);
+    }
+}
+
+template <typename Decode>
+void write_xml(const std::string& output_filename, jitana::decode_stats* stats,
+               Decode decode)
+{
+    // Construct the output stream.
+    std::ostream* os = &std::cout;
+    std::ofstream ofs;
+    if (!output_filename.empty()) {
+        ofs.open(output_filename);
+        os = &ofs;
+    }
+
+    // Decode the binary XML directly into the output.
+    jitana::xml_writer writer(*os, ' ', 2);
+    if (stats) {
+        jitana::timed_handler handler(writer, *stats);
+        decode(handler);
+        stats->bytes_out += writer.bytes_written();
+    }
+    else {
+        decode(writer);
+    }
+}
+
+/// Opens resources.arsc in the APK to print the references by name. Returns
+/// null if there is none or if it is broken.
+std::unique_ptr<jitana::resource_table>
+open_resource_table(const jitana::zip_archive& apk,
+                    const std::string& input_filename)
+{
+    const auto* e = apk.find("resources.arsc");
+    if (e == nullptr) {
+        return nullptr;
+    }
+
+    try {
+        // The table is usually stored, so it is read in place.
+        if (e->is_stored()) {
+            auto data = apk.raw_data(*e);
+            return std::make_unique<jitana::resource_table>(
+                    data.data(), data.data() + data.size());
+        }
+        return std::make_unique<jitana::resource_table>(apk.extract(*e));
+    }
+    catch (std::exception& ex) {
+        std::cerr << "warning: " << input_filename
+                  << ": resources.arsc: " << ex.what() << "\n";
+        return nullptr;
+    }
+}
+
+/// The state each worker of the thread pool reuses across the files.
+struct worker_state {
+    jitana::axml_reader reader;
+    std::vector<char> content;
+
+    /// The statistics to collect into, if any.
+    jitana::decode_stats* stats = nullptr;
+};
+
+void process_file(const std::string& input_filename,
+                  const std::string& output_filename,
+                  jitana::decode_stats* stats = nullptr)
+{
+    using jitana::decode_phase;
+    using jitana::phase_timer;
+
+    // The time not spent in the phases below is attributed to other.
+    phase_timer file_timer(stats, decode_phase::other);
+    if (stats) {
+        ++stats->files;
+    }
+
+    // The input has to be loaded before opening the output if the input file
+    // is going to be overwritten.
+    boost::system::error_code ec;
+    const bool in_place = boost::filesystem::equivalent(input_filename,
+                                                        output_filename, ec);
+
+    std::ifstream ifs(input_filename, std::ios::binary);
+    if (ifs.peek() == 'P') {
+        ifs.close();
+        std::unique_ptr<jitana::zip_archive> apk;
+        const jitana::zip_archive::entry* manifest;
+        {
+            phase_timer lookup_timer(stats, decode_phase::zip_lookup);
+            apk = std::make_unique<jitana::zip_archive>(input_filename);
+            manifest = apk->find("AndroidManifest.xml");
+        }
+        if (manifest == nullptr) {
+            throw std::runtime_error("AndroidManifest.xml is not found in APK");
+        }
+        auto table = open_resource_table(*apk, input_filename);
+        if (stats) {
+            stats->bytes_in += manifest->uncompressed_size;
+        }
+
+        if (in_place || manifest->uncompressed_size <= max_one_shot_size) {
+            std::vector<char> content;
+            {
+                phase_timer inflate_timer(stats, decode_phase::inflate);
+                content = apk->extract(*manifest);
+            }
+            auto decode = [&](jitana::axml_handler& handler) {
+                phase_timer parse_timer(stats, decode_phase::element_loop);
+                jitana::axml_reader reader;
+                reader.set_resource_table(table.get());
+                reader.set_stats(stats);
+                reader.read(content.data(), content.data() + content.size(),
+                            handler);
+            };
+            write_xml(output_filename, stats, decode);
+        }
+        else {
+            // Parse the manifest as it is inflated.
+            auto decode = [&](jitana::axml_handler& handler) {
+                jitana::axml_push_parser parser(handler, table.get());
+                parser.set_stats(stats);
+                {
+                    phase_timer inflate_timer(stats, decode_phase::inflate);
+                    apk->extract(*manifest, [&](const char* data,
+                                                size_t size) {
+                        phase_timer parse_timer(stats,
+                                                decode_phase::element_loop);
+                        parser.feed(data, size);
+                    });
+                }
+                parser.finish();
+            };
+            write_xml(output_filename, stats, decode);
+        }
+    }
+    else if (ifs.peek() == 0x03) {
+        if (in_place) {
+            std::vector<char> content(std::istreambuf_iterator<char>(ifs),
+                                      (std::istreambuf_iterator<char>()));
+            ifs.close();
+            if (stats) {
+                stats->bytes_in += content.size();
+            }
+            auto decode = [&](jitana::axml_handler& handler) {
+                phase_timer parse_timer(stats, decode_phase::element_loop);
+                jitana::axml_reader reader;
+                reader.set_stats(stats);
+                reader.read(content.data(), content.data() + content.size(),
+                            handler);
+            };
+            write_xml(output_filename, stats, decode);
+        }
+        else {
+            // Parse the file as it is read.
+            auto decode = [&](jitana::axml_handler& handler) {
+                phase_timer parse_timer(stats, decode_phase::element_loop);
+                jitana::axml_push_parser parser(handler);
+                parser.set_stats(stats);
+                std::vector<char> buffer(1 << 16);
+                while (ifs) {
+                    ifs.read(buffer.data(), buffer.size());
+                    const auto n = static_cast<size_t>(ifs.gcount());
+                    parser.feed(buffer.data(), n);
+                    if (stats) {
+                        stats->bytes_in += n;
+                    }
+                }
+                parser.finish();
+            };
+            write_xml(output_filename, stats, decode);
+        }
+    }
+    else {
+        // Load the XML into ptree.
+        boost_pt::ptree pt;
+        {
+            phase_timer parse_timer(stats, decode_phase::element_loop);
+            boost_pt::read_xml(ifs, pt,
+                               boost_pt::xml_parser::trim_whitespace);
+            ifs.close();
+        }
+        if (stats) {
+            stats->bytes_in += boost::filesystem::file_size(input_filename);
+        }
+
+        // Write the tree as an XML file.
+        write_xml(output_filename, pt, stats);
+    }
+}
+
+/// Returns true if the entry is a binary XML file decoded by
+/// decode_apk_xmls().
+bool is_xml_entry(boost::string_ref name)
+{
+    return name == "AndroidManifest.xml"
+            || (name.starts_with("res/") && name.ends_with(".xml"));
+}
+
+/// Returns true if the entry name is a relative path staying inside the
+/// output directory.
+bool is_safe_entry_name(boost::string_ref name)
+{
+    if (name.empty() || name.front() == '/'
+        || name.find_first_of("\\:") != boost::string_ref::npos) {
+        return false;
+    }
+    while (!name.empty()) {
+        auto n = std::min(name.find('/'), name.size());
+        auto component = name.substr(0, n);
+        if (component.empty() || component == "." || component == "..") {
+            return false;
+        }
+        name.remove_prefix(std::min(n + 1, name.size()));
+    }
+    return true;
+}
+
+/// Decodes AndroidManifest.xml and all the binary XML files under res/ in
+/// the APK into the output directory, mirroring the paths in the APK. The
+/// files are decoded in parallel. Returns false if any of them failed.
+bool decode_apk_xmls(const std::string& input_filename,
+                     const std::string& output_dir, size_t jobs)
+{
+    namespace fs = boost::filesystem;
+
+    jitana::zip_archive apk(input_filename);
+    auto table = open_resource_table(apk, input_filename);
+
+    // Collect the entries and create the directories beforehand so that the
+    // workers only write the files.
+    std::vector<const jitana::zip_archive::entry*> entries;
+    std::vector<std::string> errors;
+    for (const auto& e : apk.entries()) {
+        if (!is_xml_entry(e.name)) {
+            continue;
+        }
+        if (!is_safe_entry_name(e.name)) {
+            errors.push_back(e.name.to_string() + ": unsafe entry name");
+            continue;
+        }
+        if (apk.find(e.name) != &e) {
+            // Only the first one of the duplicates is used.
+            continue;
+        }
+        fs::create_directories(fs::path(output_dir)
+                               / fs::path(e.name.to_string()).parent_path());
+        entries.push_back(&e);
+    }
+
+    // Start from the largest files so that a large one does not finish
+    // last alone.
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto* a, const auto* b) {
+                         return a->uncompressed_size > b->uncompressed_size;
+                     });
+
+    // Each worker reuses its own parser and buffer.
+    jitana::thread_pool pool(jobs);
+    std::vector<worker_state> states(pool.size());
+    for (auto& state : states) {
+        state.reader.set_resource_table(table.get());
+    }
+    std::vector<std::string> entry_errors(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        pool.post([&, i](size_t worker) {
+            const auto& e = *entries[i];
+            auto& state = states[worker];
+            auto filename = fs::path(output_dir) / fs::path(e.name.to_string());
+            try {
+                apk.extract(e, state.content);
+
+                // Skip the XML files that are not compiled, like the ones
+                // in res/raw.
+                const auto& c = state.content;
+                if (c.size() < 2 || c[0] != 0x03 || c[1] != 0x00) {
+                    return;
+                }
+
+                std::ofstream ofs(filename.string());
+                if (!ofs) {
+                    throw std::runtime_error("failed to open the output file");
+                }
+                jitana::xml_writer writer(ofs, ' ', 2);
+                state.reader.read(c.data(), c.data() + c.size(), writer);
+            }
+            catch (std::exception& ex) {
+                entry_errors[i] = e.name.to_string() + ": " + ex.what();
+
+                // Do not leave the partial output.
+                boost::system::error_code ec;
+                fs::remove(filename, ec);
+            }
+        });
+    }
+    pool.wait();
+
+    // Report the errors in the order of the entries.
+    for (auto& err : entry_errors) {
+        if (!err.empty()) {
+            errors.push_back(std::move(err));
+        }
+    }
+    for (const auto& err : errors) {
+        std::cerr << "error: " << err << "\n";
+    }
+    return errors.empty();
+}
+
+/// Returns true if the name matches the pattern with the wildcards '*' and
+/// '?'.
+bool wildcard_match(boost::string_ref pattern, boost::string_ref name)
+{
+    // Backtrack to the last '*' on a mismatch.
+    size_t p = 0;
+    size_t n = 0;
+    size_t star = boost::string_ref::npos;
+    size_t star_n = 0;
+    while (n < name.size()) {
+        if (p < pattern.size()
+            && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_n = n;
+        }
+        else if (star != boost::string_ref::npos) {
+            p = star + 1;
+            n = ++star_n;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+/// Expands the inputs of the batch mode. A directory is searched
+/// recursively for the files with the extensions (in lower case), and a
+/// wildcard in the file name is matched against the files in the directory.
+/// The files found in each argument are sorted so that the order does not
+/// depend on the file system.
+std::vector<std::string>
+collect_inputs(const std::vector<std::string>& args,
+               const std::vector<std::string>& extensions = {".apk"})
+{
+    namespace fs = boost::filesystem;
+
+    std::vector<std::string> inputs;
+    for (const auto& arg : args) {
+        const fs::path path(arg);
+        const auto first = inputs.size();
+        if (fs::is_directory(path)) {
+            for (fs::recursive_directory_iterator it(path), last; it != last;
+                 ++it) {
+                auto ext = it->path().extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                if (std::find(extensions.begin(), extensions.end(), ext)
+                            != extensions.end()
+                    && fs::is_regular_file(it->status())) {
+                    inputs.push_back(it->path().string());
+                }
+            }
+        }
+        else if (path.filename().string().find_first_of("*?")
+                 != std::string::npos) {
+            const auto pattern = path.filename().string();
+            const auto dir = path.has_parent_path() ? path.parent_path()
+                                                    : fs::path(".");
+            for (fs::directory_iterator it(dir), last; it != last; ++it) {
+                if (fs::is_regular_file(it->status())
+                    && wildcard_match(pattern,
+                                      it->path().filename().string())) {
+                    inputs.push_back(path.has_parent_path()
+                                             ? it->path().string()
+                                             : it->path().filename().string());
+                }
+            }
+        }
+        else {
+            inputs.push_back(arg);
+        }
+        std::sort(inputs.begin() + first, inputs.end());
+    }
+    return inputs;
+}
+
+/// Reads the list of the inputs, one per line.
+void read_input_list(std::istream& is, std::vector<std::string>& args)
+{
+    std::string line;
+    while (std::getline(is, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            args.push_back(line);
+        }
+    }
+}
+
+/// Appends the string as a JSON string literal.
+void append_json_string(std::string& out, boost::string_ref str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out += '"';
+    for (auto c : str) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += hex[(c >> 4) & 0xf];
+                out += hex[c & 0xf];
+            }
+            else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+/// Returns the key of the APK in the decode cache.
+jitana::decode_cache_key
+make_cache_key(const std::string& input_filename,
+               const jitana::zip_archive& apk,
+               const jitana::zip_archive::entry& manifest)
+{
+    namespace fs = boost::filesystem;
+
+    jitana::decode_cache_key key;
+    key.path = fs::absolute(input_filename).string();
+    key.file_size = fs::file_size(input_filename);
+    key.mtime = fs::last_write_time(input_filename);
+    key.manifest_crc32 = manifest.crc32;
+    key.manifest_size = manifest.uncompressed_size;
+    const auto* resources = apk.find("resources.arsc");
+    key.resources_crc32 = resources ? resources->crc32 : 0;
+    return key;
+}
+
+/// What the decoded manifest depends on: the content of the binary XML and
+/// resources.arsc used to print the references. The content itself is kept
+/// since xxHash is easy to collide on purpose.
+struct manifest_key {
+    uint64_t hash;
+    std::string content;
+    uint32_t resources_crc32;
+    uint64_t resources_size;
+
+    bool operator==(const manifest_key& x) const
+    {
+        return hash == x.hash && resources_crc32 == x.resources_crc32
+                && resources_size == x.resources_size
+                && content == x.content;
+    }
+};
+
+struct manifest_key_hash {
+    size_t operator()(const manifest_key& key) const
     {
-        char* p(const_cast<char*>(base));
-        this->setg(p, p, p + size);
+        return static_cast<size_t>(key.hash);
     }
 };
 
-struct imemstream : virtual membuf, std::istream {
-    imemstream(char const* base, size_t size)
-            : membuf(base, size),
-              std::istream(static_cast<std::streambuf*>(this))
+struct manifest_cost {
+    size_t operator()(const manifest_key& key, const std::string& xml) const
     {
+        return key.content.size() + xml.size();
     }
 };
 
-std::vector<char> extract_manifest(const std::string& input_filename)
+/// The decoded manifests shared by the inputs having identical ones.
+using manifest_memo = jitana::concurrent_memo<manifest_key, std::string,
+                                              manifest_key_hash, manifest_cost>;
+
+/// The bytes of the manifests kept in the memo for the duplicates to come.
+/// The least recently seen ones are dropped beyond it.
+constexpr size_t max_memo_size = 256 << 20;
+
+/// Decodes the binary XML in state.content into the string. resources.arsc
+/// in the APK, if given, is used to print the references. The binary XML
+/// files identical to the ones decoded already are reused from the memo if
+/// it is given.
+void decode_content(const jitana::zip_archive* apk,
+                    const std::string& input_filename, worker_state& state,
+                    manifest_memo* memo, std::string& xml)
 {
-    auto* apk = unzOpen(input_filename.c_str());
-    if (apk == nullptr) {
-        throw std::runtime_error("not an APK file");
+    const auto* resources = apk ? apk->find("resources.arsc") : nullptr;
+    const auto& content = state.content;
+    auto decode = [&] {
+        std::unique_ptr<jitana::resource_table> table;
+        if (resources) {
+            table = open_resource_table(*apk, input_filename);
+        }
+
+        std::ostringstream oss;
+        jitana::xml_writer writer(oss, ' ', 2);
+        state.reader.set_resource_table(table.get());
+        if (state.stats) {
+            jitana::phase_timer timer(state.stats,
+                                      jitana::decode_phase::element_loop);
+            jitana::timed_handler handler(writer, *state.stats);
+            state.reader.read(content.data(),
+                              content.data() + content.size(), handler);
+            state.stats->bytes_in += content.size();
+            state.stats->bytes_out += writer.bytes_written();
+        }
+        else {
+            state.reader.read(content.data(),
+                              content.data() + content.size(), writer);
+        }
+        state.reader.set_resource_table(nullptr);
+        return oss.str();
+    };
+
+    if (memo) {
+        // The manifests are hashed after inflation since the identical ones
+        // can be compressed differently.
+        manifest_key key;
+        key.hash = jitana::xxhash64(content.data(), content.size());
+        key.content.assign(content.data(), content.size());
+        key.resources_crc32 = resources ? resources->crc32 : 0;
+        key.resources_size = resources ? resources->uncompressed_size : 0;
+        xml = *memo->get(key, decode);
     }
+    else {
+        xml = decode();
+    }
+}
 
-    if (unzLocateFile(apk, "AndroidManifest.xml", 0) != UNZ_OK) {
-        unzClose(apk);
+/// Returns the manifest entry in the APK.
+const jitana::zip_archive::entry& find_manifest(const jitana::zip_archive& apk)
+{
+    const auto* manifest = apk.find("AndroidManifest.xml");
+    if (manifest == nullptr) {
         throw std::runtime_error("AndroidManifest.xml is not found in APK");
     }
+    return *manifest;
+}
 
-    if (unzOpenCurrentFile(apk) != UNZ_OK) {
-        unzClose(apk);
-        throw std::runtime_error("failed to open AndroidManifest.xml in APK");
+/// Reformats the text XML file into the string.
+void reformat_xml(std::istream& is, std::string& xml,
+                  jitana::decode_stats* stats = nullptr)
+{
+    boost_pt::ptree pt;
+    {
+        jitana::phase_timer timer(stats, jitana::decode_phase::element_loop);
+        boost_pt::read_xml(is, pt, boost_pt::xml_parser::trim_whitespace);
     }
 
-    unz_file_info64 info;
-    if (unzGetCurrentFileInfo64(apk, &info, nullptr, 0, nullptr, 0, nullptr, 0)
-        != UNZ_OK) {
-        unzCloseCurrentFile(apk);
-        unzClose(apk);
-        throw std::runtime_error("failed to open AndroidManifest.xml in APK");
+    jitana::phase_timer timer(stats, jitana::decode_phase::serialization);
+    std::ostringstream oss;
+    write_xml(oss, pt);
+    xml = oss.str();
+    if (stats) {
+        stats->bytes_out += xml.size();
     }
+}
 
-    std::vector<char> content(info.uncompressed_size);
-    constexpr size_t read_size = 1 << 15;
-    for (size_t offset = 0;; offset += read_size) {
-        int len = unzReadCurrentFile(apk, content.data() + offset, read_size);
-        if (len == 0) {
-            break;
+/// Decodes the manifest in the file (an APK, a binary XML file, or a text
+/// XML file) into the string. The decoded APKs are looked up in and added to
+/// the cache if it is given.
+void decode_to_string(const std::string& input_filename, worker_state& state,
+                      jitana::decode_cache* cache, manifest_memo* memo,
+                      std::string& xml)
+{
+    using jitana::decode_phase;
+    using jitana::phase_timer;
+
+    // The time not spent in the phases below is attributed to other.
+    phase_timer file_timer(state.stats, decode_phase::other);
+    if (state.stats) {
+        ++state.stats->files;
+    }
+
+    std::ifstream ifs(input_filename, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error("failed to open the input file");
+    }
+
+    const auto c = ifs.peek();
+    if (c == 'P') {
+        ifs.close();
+        std::unique_ptr<jitana::zip_archive> apk;
+        const jitana::zip_archive::entry* manifest;
+        {
+            phase_timer lookup_timer(state.stats, decode_phase::zip_lookup);
+            apk = std::make_unique<jitana::zip_archive>(input_filename);
+            manifest = &find_manifest(*apk);
         }
-        else if (len < 0) {
-            unzCloseCurrentFile(apk);
-            unzClose(apk);
-            throw std::runtime_error(
-                    "failed to read AndroidManifest.xml in APK");
+
+        // Only the central directory is needed to find it in the cache.
+        jitana::decode_cache_key key;
+        if (cache) {
+            key = make_cache_key(input_filename, *apk, *manifest);
+            if (cache->find(key, xml)) {
+                return;
+            }
+        }
+
+        {
+            phase_timer inflate_timer(state.stats, decode_phase::inflate);
+            apk->extract(*manifest, state.content);
+        }
+        decode_content(apk.get(), input_filename, state, memo, xml);
+        if (cache) {
+            cache->insert(key, xml);
+        }
+    }
+    else if (c == 0x03) {
+        state.content.assign(std::istreambuf_iterator<char>(ifs),
+                             std::istreambuf_iterator<char>());
+        decode_content(nullptr, input_filename, state, memo, xml);
+    }
+    else {
+        reformat_xml(ifs, xml, state.stats);
+        if (state.stats) {
+            state.stats->bytes_in
+                    += boost::filesystem::file_size(input_filename);
         }
     }
+}
 
-    unzCloseCurrentFile(apk);
-    unzClose(apk);
+/// Decodes the manifest in the memory (an APK, a binary XML file, or a text
+/// XML file) into the string. The name is only used in the warnings.
+void decode_to_string(const char* first, const char* last,
+                      const std::string& input_name, worker_state& state,
+                      std::string& xml)
+{
+    if (first == last) {
+        throw std::runtime_error("the input is empty");
+    }
 
-    return content;
+    if (*first == 'P') {
+        jitana::zip_archive apk(first, last);
+        apk.extract(find_manifest(apk), state.content);
+        decode_content(&apk, input_name, state, nullptr, xml);
+    }
+    else if (*first == 0x03) {
+        state.content.assign(first, last);
+        decode_content(nullptr, input_name, state, nullptr, xml);
+    }
+    else {
+        std::istringstream iss(std::string(first, last));
+        reformat_xml(iss, xml);
+    }
 }
 
-void write_xml(const std::string& output_filename, const boost_pt::ptree& pt)
+/// Encodes the manifest in the file (a text XML file, a binary XML file, or
+/// an APK) into binary XML. The references are kept as numbers since
+/// resources.arsc is not used.
+void encode_file(const std::string& input_filename,
+                 const std::string& output_filename)
+{
+    // The input is loaded before opening the output so that the file can be
+    // encoded in-place.
+    boost_pt::ptree pt;
+    {
+        std::ifstream ifs(input_filename, std::ios::binary);
+        if (!ifs) {
+            throw std::runtime_error("failed to open the input file");
+        }
+
+        const auto c = ifs.peek();
+        if (c == 'P') {
+            ifs.close();
+            jitana::zip_archive apk(input_filename);
+            const auto content = apk.extract(find_manifest(apk));
+            jitana::read_axml(content.data(), content.data() + content.size(),
+                              pt);
+        }
+        else if (c == 0x03) {
+            jitana::read_axml(ifs, pt);
+        }
+        else {
+            // Keep the text around the child elements in place.
+            boost_pt::read_xml(ifs, pt,
+                               boost_pt::xml_parser::trim_whitespace
+                                       | boost_pt::xml_parser::no_concat_text);
+        }
+    }
+
+    std::vector<char> data;
+    jitana::write_axml(pt, data);
+
+    if (output_filename.empty()) {
+        std::cout.write(data.data(), data.size());
+        std::cout.flush();
+    }
+    else {
+        std::ofstream ofs(output_filename, std::ios::binary);
+        if (!ofs) {
+            throw std::runtime_error("failed to open the output file");
+        }
+        ofs.write(data.data(), data.size());
+    }
+}
+
+/// Prints the statistics to the standard error in the format ("text" or
+/// "json").
+void print_stats(const jitana::decode_stats& stats, const std::string& format)
+{
+    if (format == "json") {
+        stats.write_json(std::cerr);
+    }
+    else {
+        stats.write_text(std::cerr);
+    }
+}
+
+/// Decodes the inputs in parallel and writes a JSON object per line for
+/// each of them in the order of the inputs: {"input": ..., "xml": ...} if
+/// succeeded, or {"input": ..., "error": ...} if failed. Identical manifests
+/// are decoded only once. The statistics of all the inputs are printed in
+/// the format ("text" or "json") if given, with the hardware events if
+/// counters is true and the allocations if allocs is true. Returns false if
+/// any of them failed.
+bool process_batch(const std::vector<std::string>& inputs,
+                   const std::string& output_filename, size_t jobs,
+                   jitana::decode_cache* cache,
+                   const std::string& stats_format, bool counters, bool allocs)
 {
-    // Construct the output stream.
     std::ostream* os = &std::cout;
     std::ofstream ofs;
     if (!output_filename.empty()) {
-        ofs.open(output_filename);
+        ofs.open(output_filename, std::ios::binary);
+        if (!ofs) {
+            throw std::runtime_error("failed to open the output file");
+        }
         os = &ofs;
     }
 
-    // Write the ptree to the output.
-    {
-#if BOOST_MAJOR_VERSION == 1 && BOOST_MINOR_VERSION < 56
-        boost_pt::xml_writer_settings<char> settings(' ', 2);
+    jitana::thread_pool pool(jobs);
+    std::vector<worker_state> states(pool.size());
+    manifest_memo memo(max_memo_size);
+
+    // Each worker collects the statistics on its own.
+    std::vector<jitana::decode_stats> stats;
+    if (!stats_format.empty()) {
+        stats.resize(pool.size());
+        for (size_t i = 0; i < stats.size(); ++i) {
+            states[i].stats = &stats[i];
+            states[i].reader.set_stats(&stats[i]);
+            if (counters) {
+                stats[i].enable_counters();
+            }
+            if (allocs) {
+                stats[i].enable_alloc_tracking();
+            }
+        }
+    }
+
+    // The records finished out of order wait here until the preceding ones
+    // are written.
+    std::mutex mutex;
+    std::vector<std::string> records(inputs.size());
+    std::vector<char> finished(inputs.size());
+    size_t next = 0;
+    size_t failed = 0;
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        pool.post([&, i](size_t worker) {
+            std::string record = "{\"input\":";
+            append_json_string(record, inputs[i]);
+            bool succeeded = true;
+            try {
+                std::string xml;
+                decode_to_string(inputs[i], states[worker], cache, &memo, xml);
+                record += ",\"xml\":";
+                append_json_string(record, xml);
+            }
+            catch (std::exception& e) {
+                record += ",\"error\":";
+                append_json_string(record, e.what());
+                succeeded = false;
+            }
+            if (allocs && jitana::decode_stats::alloc_tracking_available()) {
+                // Point out the inputs taking much memory.
+                record += ",\"peak_live_bytes\":"
+                        + std::to_string(
+                                  states[worker].stats->last_peak_live_bytes());
+            }
+            record += "}\n";
+
+            std::lock_guard<std::mutex> lock(mutex);
+            failed += succeeded ? 0 : 1;
+            records[i] = std::move(record);
+            finished[i] = true;
+            for (; next < inputs.size() && finished[next]; ++next) {
+                os->write(records[next].data(), records[next].size());
+                std::string().swap(records[next]);
+            }
+        });
+    }
+    pool.wait();
+
+    os->flush();
+    if (cache) {
+        cache->flush();
+    }
+
+    std::cerr << "axmldec: " << inputs.size() << " inputs, " << failed
+              << " failed, " << memo.hits() << " duplicate manifests\n";
+    if (!stats.empty()) {
+        jitana::decode_stats total;
+        for (const auto& s : stats) {
+            total.merge(s);
+        }
+        total.peak_rss = jitana::peak_rss_bytes();
+        print_stats(total, stats_format);
+    }
+    return failed == 0;
+}
+
+/// Returns the percentile (0 to 1) of the sorted samples.
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto i = static_cast<size_t>(p * sorted.size());
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+/// The file the output is discarded into.
+#ifdef _WIN32
+constexpr const char* null_device = "NUL";
 #else
-        boost_pt::xml_writer_settings<std::string> settings(' ', 2);
+constexpr const char* null_device = "/dev/null";
 #endif
-        boost_pt::write_xml(*os, pt, settings);
+
+/// Decodes each input with process_file() as the single file mode does, and
+/// writes the throughput and the latencies as a JSON object. The inputs are
+/// decoded once before the measurement so that they are in the page cache.
+/// If the baseline, a JSON object written by a previous run, is given,
+/// returns false if any of the metrics is worse by more than the threshold
+/// (in percent). The baseline must be of the same inputs.
+bool run_benchmark(const std::vector<std::string>& inputs, size_t repeat,
+                   const std::string& output_filename,
+                   const std::string& baseline_filename, double threshold)
+{
+    using clock = std::chrono::steady_clock;
+
+    if (repeat == 0) {
+        throw std::runtime_error("--repeat must be at least 1");
     }
+
+    uint64_t bytes = 0;
+    std::vector<std::string> files;
+    for (const auto& input : inputs) {
+        try {
+            process_file(input, null_device);
+            bytes += boost::filesystem::file_size(input);
+            files.push_back(input);
+        }
+        catch (std::exception& e) {
+            std::cerr << "warning: " << input << ": " << e.what() << "\n";
+        }
+    }
+    if (files.empty()) {
+        throw std::runtime_error("no input decoded successfully");
+    }
+
+    // Comparing the inputs of different sizes tells nothing, so fail before
+    // the measurement.
+    boost_pt::ptree baseline;
+    if (!baseline_filename.empty()) {
+        boost_pt::read_json(baseline_filename, baseline);
+        const auto base_files = baseline.get<uint64_t>("files", 0);
+        const auto base_bytes = baseline.get<uint64_t>("bytes", 0);
+        if (base_files != files.size() || base_bytes != bytes) {
+            throw std::runtime_error(
+                    "the baseline is of different inputs ("
+                    + std::to_string(base_files) + " files, "
+                    + std::to_string(base_bytes) + " bytes instead of "
+                    + std::to_string(files.size()) + " files, "
+                    + std::to_string(bytes) + " bytes)");
+        }
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(files.size() * repeat);
+    const auto start = clock::now();
+    for (size_t i = 0; i < repeat; ++i) {
+        for (const auto& file : files) {
+            const auto t = clock::now();
+            process_file(file, null_device);
+            latencies.push_back(
+                    std::chrono::duration<double, std::milli>(clock::now() - t)
+                            .count());
+        }
+    }
+    const auto seconds
+            = std::chrono::duration<double>(clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto p50 = percentile(latencies, 0.5);
+    const auto p99 = percentile(latencies, 0.99);
+    const auto files_per_second = files.size() * repeat / seconds;
+    const auto mb_per_second = bytes * repeat / seconds / (1 << 20);
+
+    {
+        std::ostream* os = &std::cout;
+        std::ofstream ofs;
+        if (!output_filename.empty()) {
+            ofs.open(output_filename);
+            os = &ofs;
+        }
+        *os << "{\"files\":" << files.size() << ",\"bytes\":" << bytes
+            << ",\"repeat\":" << repeat << ",\"seconds\":" << seconds
+            << ",\"files_per_second\":" << files_per_second
+            << ",\"mb_per_second\":" << mb_per_second
+            << ",\"latency_ms\":{\"p50\":" << p50 << ",\"p99\":" << p99
+            << ",\"max\":" << latencies.back() << "}}\n";
+    }
+
+    if (baseline_filename.empty()) {
+        return true;
+    }
+
+    // The throughputs are better when higher, and the latencies are better
+    // when lower. The maximum latency is too noisy to compare.
+    struct metric {
+        const char* path;
+        double value;
+        bool higher_is_better;
+    };
+    const metric metrics[] = {{"files_per_second", files_per_second, true},
+                              {"mb_per_second", mb_per_second, true},
+                              {"latency_ms.p50", p50, false},
+                              {"latency_ms.p99", p99, false}};
+
+    bool passed = true;
+    for (const auto& m : metrics) {
+        const auto base = baseline.get<double>(m.path);
+        if (base <= 0) {
+            continue;
+        }
+        const auto change = (m.value - base) / base * 100;
+        const bool regressed = m.higher_is_better ? -change > threshold
+                                                  : change > threshold;
+        std::cerr << (regressed ? "REGRESSED " : "ok        ") << m.path
+                  << ": " << base << " -> " << m.value << " ("
+                  << (change >= 0 ? "+" : "") << change << "%)\n";
+        passed = passed && !regressed;
+    }
+    return passed;
 }
 
-void process_file(const std::string& input_filename,
-                  const std::string& output_filename)
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+namespace asio = boost::asio;
+using local_socket = asio::local::stream_protocol::socket;
+
+/// The types of the messages of --serve. Each message is the type (a byte)
+/// followed by the size of the body (32-bit little-endian) and the body.
+constexpr char request_path = 'P';
+constexpr char request_data = 'D';
+constexpr char request_stats = 'S';
+constexpr char response_ok = 'O';
+constexpr char response_error = 'E';
+
+/// The largest body of a request accepted.
+constexpr uint32_t max_request_size = 256 << 20;
+
+/// The connections served at once. The others wait in the listen backlog
+/// until some are closed.
+constexpr size_t max_connections = 64;
+
+/// The bodies of the requests held in memory at once by all the
+/// connections.
+constexpr uint64_t max_buffered_size = uint64_t(1) << 30;
+
+/// The bytes of the request bodies that the connections may hold. A
+/// connection waits until the body it is about to read fits.
+class request_budget {
+public:
+    /// Holds the bytes acquired from the budget until destroyed.
+    class lease {
+    public:
+        lease(request_budget& budget, uint64_t size)
+                : budget_(budget), size_(size)
+        {
+            budget_.acquire(size_);
+        }
+
+        ~lease()
+        {
+            budget_.release(size_);
+        }
+
+        lease(const lease&) = delete;
+        lease& operator=(const lease&) = delete;
+
+    private:
+        request_budget& budget_;
+        uint64_t size_;
+    };
+
+    explicit request_budget(uint64_t capacity) : available_(capacity)
+    {
+    }
+
+    void acquire(uint64_t size)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        released_.wait(lock, [&] { return available_ >= size; });
+        available_ -= size;
+    }
+
+    void release(uint64_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            available_ += size;
+        }
+        released_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable released_;
+    uint64_t available_;
+};
+
+/// The numbers, the sizes, and the latencies of the requests served.
+class serve_stats {
+public:
+    void add(double latency, size_t bytes_in, size_t bytes_out,
+             bool succeeded)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (recent_.size() < max_recent) {
+            recent_.push_back(latency);
+        }
+        else {
+            recent_[requests_ % max_recent] = latency;
+        }
+        ++requests_;
+        errors_ += succeeded ? 0 : 1;
+        bytes_in_ += bytes_in;
+        bytes_out_ += bytes_out;
+        total_latency_ += latency;
+        max_latency_ = std::max(max_latency_, latency);
+    }
+
+    /// Returns the statistics as a JSON object. The latencies are in
+    /// milliseconds, and the percentiles are of the recent requests.
+    std::string to_json() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto sorted = recent_;
+        std::sort(begin(sorted), end(sorted));
+
+        const auto uptime = std::chrono::duration<double>(
+                                    std::chrono::steady_clock::now() - start_)
+                                    .count();
+        std::ostringstream oss;
+        oss << "{\"uptime\":" << uptime << ",\"requests\":" << requests_
+            << ",\"errors\":" << errors_
+            << ",\"requests_per_second\":" << requests_ / uptime
+            << ",\"bytes_in\":" << bytes_in_
+            << ",\"bytes_out\":" << bytes_out_ << ",\"latency\":{\"mean\":"
+            << (requests_ ? total_latency_ / requests_ : 0.0)
+            << ",\"p50\":" << percentile(sorted, 0.5)
+            << ",\"p99\":" << percentile(sorted, 0.99)
+            << ",\"max\":" << max_latency_ << "}}";
+        return oss.str();
+    }
+
+private:
+    static constexpr size_t max_recent = 4096;
+
+    mutable std::mutex mutex_;
+    std::chrono::steady_clock::time_point start_
+            = std::chrono::steady_clock::now();
+    uint64_t requests_ = 0;
+    uint64_t errors_ = 0;
+    uint64_t bytes_in_ = 0;
+    uint64_t bytes_out_ = 0;
+    double total_latency_ = 0;
+    double max_latency_ = 0;
+    std::vector<double> recent_;
+};
+
+constexpr size_t serve_stats::max_recent;
+
+void write_message(local_socket& socket, char type, boost::string_ref body,
+                   boost::system::error_code& ec)
 {
-    // Property tree for storing the XML content.
-    boost_pt::ptree pt;
+    const auto size = static_cast<uint32_t>(body.size());
+    const char header[5] = {type,
+                            static_cast<char>(size),
+                            static_cast<char>(size >> 8),
+                            static_cast<char>(size >> 16),
+                            static_cast<char>(size >> 24)};
+    const std::array<asio::const_buffer, 2> buffers{
+            {asio::buffer(header), asio::buffer(body.data(), body.size())}};
+    asio::write(socket, buffers, ec);
+}
 
-    // Load the XML into ptree.
-    std::ifstream ifs(input_filename, std::ios::binary);
-    if (ifs.peek() == 'P') {
-        auto content = extract_manifest(input_filename);
-        imemstream ims(content.data(), content.size());
-        jitana::read_axml(ims, pt);
+/// Answers the requests on the connection until it is closed. The requests
+/// are decoded by the pool one at a time; the clients open more connections
+/// to have them decoded in parallel.
+void serve_connection(local_socket& socket, jitana::thread_pool& pool,
+                      std::vector<worker_state>& states,
+                      jitana::decode_cache* cache, serve_stats& stats,
+                      request_budget& budget)
+{
+    std::vector<char> body;
+    std::string result;
+    boost::system::error_code ec;
+    for (;;) {
+        // The large bodies are not kept while waiting for the next request.
+        if (body.capacity() > (1 << 20)) {
+            std::vector<char>().swap(body);
+        }
+
+        unsigned char header[5];
+        asio::read(socket, asio::buffer(header), ec);
+        if (ec) {
+            return;
+        }
+        const char type = header[0];
+        const uint32_t size = header[1] | header[2] << 8 | header[3] << 16
+                | static_cast<uint32_t>(header[4]) << 24;
+        if (size > max_request_size) {
+            write_message(socket, response_error, "the request is too large",
+                          ec);
+            return;
+        }
+        request_budget::lease lease(budget, size);
+        body.resize(size);
+        asio::read(socket, asio::buffer(body), ec);
+        if (ec) {
+            return;
+        }
+
+        if (type == request_stats) {
+            write_message(socket, response_ok, stats.to_json(), ec);
+            if (ec) {
+                return;
+            }
+            continue;
+        }
+
+        // Let a worker, which has its parser warmed up, decode it.
+        const auto start = std::chrono::steady_clock::now();
+        bool succeeded = false;
+        std::promise<void> done;
+        auto finished = done.get_future();
+        pool.post([&](size_t worker) {
+            try {
+                if (type == request_path) {
+                    decode_to_string(std::string(body.data(), body.size()),
+                                     states[worker], cache, nullptr, result);
+                }
+                else if (type == request_data) {
+                    decode_to_string(body.data(), body.data() + body.size(),
+                                     "<data>", states[worker], result);
+                }
+                else {
+                    throw std::runtime_error("unknown request type");
+                }
+                succeeded = true;
+            }
+            catch (std::exception& e) {
+                result = e.what();
+            }
+            done.set_value();
+        });
+        finished.wait();
+
+        write_message(socket, succeeded ? response_ok : response_error, result,
+                      ec);
+        if (ec) {
+            return;
+        }
+        stats.add(std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count(),
+                  body.size(), result.size(), succeeded);
     }
-    else if (ifs.peek() == 0x03) {
-        jitana::read_axml(ifs, pt);
+}
+
+/// Serves the decode requests on the Unix domain socket until SIGINT or
+/// SIGTERM is received. Each connection is read by its own thread, up to
+/// max_connections of them, and the files are decoded by the pool of the
+/// workers kept running.
+void serve(const std::string& socket_path, size_t jobs,
+           jitana::decode_cache* cache)
+{
+    namespace fs = boost::filesystem;
+    namespace errc = boost::system::errc;
+    using boost::system::error_code;
+
+    // Replace the socket left by a server killed.
+    error_code ec;
+    if (fs::status(socket_path, ec).type() == fs::socket_file) {
+        fs::remove(socket_path);
     }
-    else {
-        boost_pt::read_xml(ifs, pt, boost_pt::xml_parser::trim_whitespace);
+
+    // The clients going away must not kill the server.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    jitana::thread_pool pool(jobs);
+    std::vector<worker_state> states(pool.size());
+    serve_stats stats;
+
+    asio::io_service io;
+    asio::local::stream_protocol::acceptor acceptor(
+            io, asio::local::stream_protocol::endpoint(socket_path));
+
+    // The connections open, which are shut down when the server stops.
+    std::mutex mutex;
+    std::condition_variable connection_closed;
+    std::set<local_socket*> sockets;
+    bool accepting = true;
+    request_budget budget(max_buffered_size);
+
+    std::function<void()> accept;
+    auto start_connection = [&](std::shared_ptr<local_socket> socket) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sockets.insert(socket.get());
+        std::thread([&, socket]() mutable {
+            serve_connection(*socket, pool, states, cache, stats, budget);
+            std::lock_guard<std::mutex> lock(mutex);
+            sockets.erase(socket.get());
+            socket.reset();
+            if (!accepting) {
+                // Resume accepting stopped at max_connections.
+                accepting = true;
+                io.post(accept);
+            }
+            connection_closed.notify_all();
+        }).detach();
+
+        // Leave the others in the backlog until some are closed.
+        if (sockets.size() >= max_connections) {
+            accepting = false;
+        }
+        return accepting;
+    };
+
+    // Keep serving after a failure other than closing the acceptor. If
+    // the descriptors ran out, give the connections time to close some.
+    // Only the first of the failures in a row is reported.
+    asio::steady_timer retry_timer(io);
+    bool accept_failed = false;
+    auto retry_accept = [&](const error_code& error) {
+        if (!accept_failed) {
+            std::cerr << "axmldec: failed to accept: " << error.message()
+                      << "\n";
+            accept_failed = true;
+        }
+        const bool no_descriptors = error == asio::error::no_descriptors
+                || error == errc::too_many_files_open_in_system;
+        retry_timer.expires_from_now(
+                std::chrono::milliseconds(no_descriptors ? 100 : 0));
+        retry_timer.async_wait([&](const error_code& ec) {
+            if (!ec) {
+                accept();
+            }
+        });
+    };
+
+    accept = [&] {
+        if (!acceptor.is_open()) {
+            return;
+        }
+        auto socket = std::make_shared<local_socket>(io);
+        acceptor.async_accept(*socket, [&, socket](const error_code& error) {
+            if (error == asio::error::operation_aborted) {
+                return;
+            }
+            if (error) {
+                retry_accept(error);
+                return;
+            }
+            accept_failed = false;
+            if (start_connection(socket)) {
+                accept();
+            }
+        });
+    };
+    accept();
+
+    asio::signal_set signals(io, SIGINT, SIGTERM);
+    signals.async_wait([&](const error_code&, int) {
+        acceptor.close();
+        retry_timer.cancel();
+    });
+
+    std::cerr << "axmldec: serving on " << socket_path << "\n";
+    io.run();
+
+    // Wake up the threads reading the connections, and wait for them.
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (auto* s : sockets) {
+            ::shutdown(s->native_handle(), SHUT_RDWR);
+        }
+        connection_closed.wait(lock, [&] { return sockets.empty(); });
     }
 
-    // Write the tree as an XML file.
-    write_xml(output_filename, pt);
+    fs::remove(socket_path, ec);
+    if (cache) {
+        cache->flush();
+    }
+    std::cerr << "axmldec: " << stats.to_json() << "\n";
+}
+#else
+void serve(const std::string& /*socket_path*/, size_t /*jobs*/,
+           jitana::decode_cache* /*cache*/)
+{
+    throw std::runtime_error("--serve is not supported on this platform");
 }
+#endif
 
 int main(int argc, char** argv)
 {
@@ -145,8 +1445,39 @@ int main(int argc, char** argv)
     po::options_description desc("Allowed options");
     desc.add_options()("help", "Display available options")(
             "version", "Display version number")(
-            "input-file,i", po::value<std::string>(), "Input file")(
-            "output-file,o", po::value<std::string>(), "Output file");
+            "input-file,i", po::value<std::vector<std::string>>(),
+            "Input file")(
+            "output-file,o", po::value<std::string>(), "Output file")(
+            "output-dir,d", po::value<std::string>(),
+            "Decode all binary XML files in APK into directory")(
+            "encode,e", "Encode input file into binary XML")(
+            "batch,b",
+            "Decode many input files, directories, or wildcards into JSON "
+            "lines")(
+            "input-list,l", po::value<std::string>(),
+            "File listing input files for --batch (- for stdin)")(
+            "cache,c", po::value<std::string>(),
+            "Directory caching decoded APKs for --batch or --serve")(
+            "serve", po::value<std::string>(),
+            "Serve decode requests on Unix domain socket")(
+            "benchmark",
+            "Measure throughput and latency of decoding inputs one by one")(
+            "repeat", po::value<size_t>()->default_value(3),
+            "Number of times --benchmark decodes each input")(
+            "baseline", po::value<std::string>(),
+            "JSON written by previous --benchmark to compare with")(
+            "threshold", po::value<double>()->default_value(10),
+            "Regression from --baseline to fail on in percent")(
+            "stats", "Print time per phase and counts to stderr")(
+            "stats-format", po::value<std::string>()->default_value("text"),
+            "Format of --stats (text or json)")(
+            "perf-counters",
+            "Count hardware events per phase in --stats (Linux only)")(
+            "alloc-stats",
+            "Count heap allocations and peak live bytes per phase in "
+            "--stats")(
+            "jobs,j", po::value<size_t>()->default_value(0),
+            "Number of threads (0 for all cores)");
     po::positional_options_description p;
     p.add("input-file", -1);
 
@@ -171,21 +1502,119 @@ int main(int argc, char** argv)
             return 0;
         }
 
-        if (vmap.count("help") || !vmap.count("input-file")) {
+        if (vmap.count("help")
+            || !(vmap.count("input-file") || vmap.count("input-list")
+                 || vmap.count("serve"))) {
             // Print help and quit.
-            std::cout << "Usage: axmldec [options] <input_file>\n\n";
+            std::cout << "Usage: axmldec [options] <input_file>\n";
+            std::cout << "       axmldec [options] --batch <input>...\n";
+            std::cout << "       axmldec [options] --serve <socket>\n";
+            std::cout << "       axmldec [options] --benchmark <input>...\n\n";
             std::cout << desc << "\n";
             return 0;
         }
 
+        std::unique_ptr<jitana::decode_cache> cache;
+        if (vmap.count("cache")) {
+            cache = std::make_unique<jitana::decode_cache>(
+                    vmap["cache"].as<std::string>());
+        }
+
+        if (vmap.count("serve")) {
+            // Keep decoding the requests until stopped.
+            serve(vmap["serve"].as<std::string>(), vmap["jobs"].as<size_t>(),
+                  cache.get());
+            return 0;
+        }
+
+        std::vector<std::string> input_filenames;
         if (vmap.count("input-file")) {
-            auto input_filename = vmap["input-file"].as<std::string>();
-            auto output_filename = vmap.count("output-file")
-                    ? vmap["output-file"].as<std::string>()
-                    : "";
+            input_filenames
+                    = vmap["input-file"].as<std::vector<std::string>>();
+        }
+        auto output_filename = vmap.count("output-file")
+                ? vmap["output-file"].as<std::string>()
+                : "";
+        std::string stats_format;
+        const bool counters = vmap.count("perf-counters") != 0;
+        const bool allocs = vmap.count("alloc-stats") != 0;
+        if (vmap.count("stats") || counters || allocs) {
+            stats_format = vmap["stats-format"].as<std::string>();
+            if (stats_format != "text" && stats_format != "json") {
+                throw std::runtime_error("--stats-format must be text or json");
+            }
+        }
+
+        if (vmap.count("benchmark")) {
+            // Measure the single file mode on the inputs.
+            return run_benchmark(
+                           collect_inputs(input_filenames,
+                                          {".apk", ".axml", ".xml"}),
+                           vmap["repeat"].as<size_t>(), output_filename,
+                           vmap.count("baseline")
+                                   ? vmap["baseline"].as<std::string>()
+                                   : "",
+                           vmap["threshold"].as<double>())
+                    ? 0
+                    : 1;
+        }
 
-            // Process the file.
-            process_file(input_filename, output_filename);
+        if (vmap.count("batch")) {
+            // Decode all the inputs in one process.
+            if (vmap.count("input-list")) {
+                const auto& list = vmap["input-list"].as<std::string>();
+                if (list == "-") {
+                    read_input_list(std::cin, input_filenames);
+                }
+                else {
+                    std::ifstream ifs(list);
+                    if (!ifs) {
+                        throw std::runtime_error(
+                                "failed to open the input list");
+                    }
+                    read_input_list(ifs, input_filenames);
+                }
+            }
+            return process_batch(collect_inputs(input_filenames),
+                                 output_filename, vmap["jobs"].as<size_t>(),
+                                 cache.get(), stats_format, counters,
+                                 allocs)
+                    ? 0
+                    : 1;
+        }
+
+        if (input_filenames.size() != 1) {
+            throw std::runtime_error("use --batch for multiple input files");
+        }
+        const auto& input_filename = input_filenames.front();
+
+        if (vmap.count("encode")) {
+            // Convert the file back to binary XML.
+            encode_file(input_filename, output_filename);
+            return 0;
+        }
+
+        if (vmap.count("output-dir")) {
+            // Decode all the binary XML files in the APK.
+            return decode_apk_xmls(input_filename,
+                                   vmap["output-dir"].as<std::string>(),
+                                   vmap["jobs"].as<size_t>())
+                    ? 0
+                    : 1;
+        }
+
+        // Process the file.
+        jitana::decode_stats stats;
+        if (counters) {
+            stats.enable_counters();
+        }
+        if (allocs) {
+            stats.enable_alloc_tracking();
+        }
+        process_file(input_filename, output_filename,
+                     stats_format.empty() ? nullptr : &stats);
+        if (!stats_format.empty()) {
+            print_stats(stats, stats_format);
         }
     }
     catch (std::ios::failure& e) {